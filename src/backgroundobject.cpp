@@ -1,8 +1,8 @@
 #include "backgroundobject.hpp"
 
-BackgroundObject::BackgroundObject()
+BackgroundObject::BackgroundObject(EntityStore& store)
 
-	: GameObject{ GameObject::BACKGROUND, 1.0f, glm::quat(glm::vec3(0.49f, 1.0f, -1.0f)), 0.5f,
+	: GameObject{ store, GameObject::BACKGROUND, 1.0f, glm::quat(glm::vec3(0.49f, 1.0f, -1.0f)), 0.5f,
 	              10.f, glm::vec3(glm::half_pi<float>(), 0.f, -glm::half_pi<float>()) },
 	  GeometryHandler("background", "background")
 {
@@ -22,7 +22,7 @@ class BackgroundObject : public GameObject, private GeometryHandler
 {
 public:
 	//No default ctor
-	BackgroundObject();
+	BackgroundObject(EntityStore& store);
 
 	//Dtor
 	~BackgroundObject();
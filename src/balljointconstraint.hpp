@@ -19,6 +19,10 @@ public:
 	//Test if q is in the allowed range
 	bool isInRange(const glm::quat& q) const;
 
+	//Accessors, used by batch kernels doing the range test themselves
+	const glm::vec3& getCenter() const { return mCenter; }
+	const glm::vec3& getPlanePos() const { return mPlanePos; }
+
 private:
 	//Returns the closest quat that is in the allowed range, assuming q is outside,
 	//i.e. returns the closest quat on the edge of the allowed range
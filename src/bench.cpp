@@ -0,0 +1,849 @@
+//
+//  Benchmarks and checks of the master's building blocks, kept out of the headless run
+//  so that one only measures throughput. Each argument selects a case:
+//      DomedagenBench parse queue
+//  "all" runs every case, no argument lists them. Settings are in [Bench] in config.ini
+//  Returns failure if a check of any selected case fails
+//
+#include <vector>
+#include <string>
+#include <sstream>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <iterator>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <random>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+
+#include <glm/gtc/constants.hpp>
+
+#include "sgct/log.h"
+#include "sgct/profiling.h"
+
+#include "utility.hpp"
+#include "inireader.h"
+#include "simulation.hpp"
+#include "statesync.hpp"
+#include "loadgenerator.hpp"
+#include "inputprotocol.hpp"
+#include "messagering.hpp"
+#include "servermessages.hpp"
+#include "spheregrid.hpp"
+#include "integrator.hpp"
+
+using namespace sgct;
+
+//Every allocation of the program goes through these, the alloc case counts them
+namespace {
+	std::atomic<uint64_t> numAllocations{ 0 };
+} // namespace
+
+void* operator new(std::size_t size)
+{
+	++numAllocations;
+	if (void* p = std::malloc(size > 0 ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	++numAllocations;
+	const size_t align = static_cast<size_t>(alignment);
+	//aligned_alloc wants a multiple of the alignment
+	const size_t rounded = (std::max<size_t>(size, 1) + align - 1) / align * align;
+#ifdef _MSC_VER
+	if (void* p = _aligned_malloc(rounded, align))
+#else
+	if (void* p = std::aligned_alloc(align, rounded))
+#endif
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+#ifdef _MSC_VER
+	_aligned_free(p);
+#else
+	std::free(p);
+#endif
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t alignment) noexcept
+{
+	operator delete(p, alignment);
+}
+
+namespace {
+	//Decode the same C messages numMessages times in both formats and log the throughput
+	void benchmarkInputParsing(unsigned numMessages, size_t numPlayers)
+	{
+		ZoneScoped;
+		std::vector<std::vector<std::byte>> binary(numPlayers);
+		std::vector<std::string> text(numPlayers);
+		for (uint32_t id = 0; id < numPlayers; id++)
+		{
+			//Joystick angles, the worst case for the text parser
+			const InputMessage message{ 'C', id, id, 0.0123456f * id - 0.7f, {} };
+			InputProtocol::encodeBinary(message, binary[id]);
+			InputProtocol::encodeText(message, text[id]);
+		}
+
+		auto run = [numMessages, numPlayers](const char* name, auto decodeOne) {
+			InputMessage message;
+			double checksum = 0.0;
+			const auto start = std::chrono::steady_clock::now();
+			for (unsigned i = 0; i < numMessages; i++)
+			{
+				decodeOne(i % numPlayers, message);
+				checksum += message.mValue;
+			}
+			const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			Log::Info("Input parsing, %s: %.1f ns per message, %.2f M messages/s (checksum %.1f)",
+				name, 1e9 * seconds / numMessages, numMessages / seconds / 1e6, checksum);
+		};
+
+		run("binary", [&binary](size_t id, InputMessage& message) {
+			InputProtocol::decode(binary[id].data(), binary[id].size(), message);
+		});
+		run("text", [&text](size_t id, InputMessage& message) {
+			InputProtocol::decode(text[id].data(), text[id].size(), message);
+		});
+		//What messageReceived did before the binary protocol, for reference
+		run("text with istringstream", [&text](size_t id, InputMessage& message) {
+			std::istringstream iss(text[id]);
+			char msgType;
+			iss >> msgType;
+			std::tuple<unsigned int, float> turnSpeed = Utility::getTurnSpeed(iss);
+			message.mPlayerId = std::get<0>(turnSpeed);
+			message.mValue = std::get<1>(turnSpeed);
+		});
+	}
+
+	//Score storms: all numPlayers players score in the same frame, as at the end of a game. Each
+	//storm is queued and then drained once per service cycle, the way WebSocketHandler
+	//does. Compares the previous queue of vectors, one message per cycle, to MessageRing
+	//with one text message per score and with a single scoreboard message
+	void benchmarkOutgoingQueue(unsigned numStorms, size_t numPlayers)
+	{
+		ZoneScoped;
+		//Same padding as LWS_PRE in a typical libwebsockets build
+		constexpr size_t padding = 16;
+		std::vector<std::string> storm(numPlayers);
+		for (size_t id = 0; id < storm.size(); id++)
+			storm[id] = "P " + std::to_string(id) + "   " + std::to_string(10 * id);
+
+		auto report = [numStorms, &storm](const char* name, double seconds, uint64_t cycles, size_t bytes) {
+			const double messages = static_cast<double>(numStorms) * storm.size();
+			Log::Info("Outgoing queue, %s: %.2f M messages/s, %.1f us per storm, %.1f service cycles "
+				"until a storm is sent (%zu bytes)", name, messages / seconds / 1e6,
+				1e6 * seconds / numStorms, static_cast<double>(cycles) / numStorms, bytes);
+		};
+
+		{
+			std::vector<std::vector<std::byte>> queue;
+			size_t bytes = 0;
+			uint64_t cycles = 0;
+			const auto start = std::chrono::steady_clock::now();
+			for (unsigned i = 0; i < numStorms; i++)
+			{
+				for (const std::string& message : storm)
+				{
+					std::vector<std::byte> msg(message.size());
+					std::transform(message.begin(), message.end(), msg.begin(),
+						[](char c) { return static_cast<std::byte>(c); });
+					queue.push_back(std::move(msg));
+				}
+				while (!queue.empty())
+				{
+					std::vector<std::byte> msg = queue.front();
+					queue.erase(queue.begin());
+					std::vector<std::byte> buffer(padding + msg.size());
+					std::fill(buffer.begin(), buffer.end(), std::byte(0));
+					std::copy(msg.begin(), msg.end(), buffer.begin() + padding);
+					bytes += msg.size();
+					++cycles;
+				}
+			}
+			report("vector queue", std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(),
+				cycles, bytes);
+		}
+
+		{
+			MessageRing queue(64 * 1024, padding);
+			size_t bytes = 0;
+			uint64_t cycles = 0;
+			const auto start = std::chrono::steady_clock::now();
+			for (unsigned i = 0; i < numStorms; i++)
+			{
+				for (const std::string& message : storm)
+					queue.push(reinterpret_cast<const std::byte*>(message.data()), message.size());
+				size_t size;
+				if (queue.frontBatch(size))
+				{
+					queue.popBatch();
+					bytes += size;
+					++cycles;
+				}
+			}
+			report("batches", std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(),
+				cycles, bytes);
+		}
+
+		//The same scores as one scoreboard message per storm, as Game::sendUpdatesToServer
+		{
+			std::vector<std::pair<unsigned, int>> points(storm.size());
+			for (size_t id = 0; id < points.size(); id++)
+				points[id] = { static_cast<unsigned>(id), static_cast<int>(10 * id) };
+			std::vector<std::byte> scoreboard;
+			MessageRing queue(64 * 1024, padding);
+			size_t bytes = 0;
+			uint64_t cycles = 0;
+			const auto start = std::chrono::steady_clock::now();
+			for (unsigned i = 0; i < numStorms; i++)
+			{
+				ServerMessages::encodeScoreboard(points, false, 0.f, scoreboard);
+				queue.push(scoreboard.data(), scoreboard.size());
+				size_t size;
+				if (queue.frontBatch(size))
+				{
+					queue.popBatch();
+					bytes += size;
+					++cycles;
+				}
+			}
+			report("batch with scoreboard", std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(),
+				cycles, bytes);
+		}
+	}
+
+	//Step a full server of players over a dome full of collectibles numSteps times with 1 to
+	//every core and log the step time. The points and positions must not depend on the number
+	//of threads, the checksum of each run is compared to the single threaded one. Returns
+	//false if any differs
+	bool benchmarkJobScaling(unsigned numSteps, unsigned seed, size_t numPlayers, size_t numCollectibles)
+	{
+		ZoneScoped;
+		const unsigned maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+		double serialTime = 0.0;
+		double serialChecksum = 0.0;
+		bool isSame = true;
+		for (unsigned numThreads = 1; numThreads <= maxThreads; numThreads++)
+		{
+			Simulation simulation;
+			simulation.init(numPlayers, numCollectibles, seed);
+			simulation.setThreads(numThreads);
+			simulation.setTickRate(60.0, 1);
+			simulation.setMaxTime(std::numeric_limits<float>::max());
+
+			std::mt19937 random(seed);
+			std::uniform_real_distribution<float> turn(-1.f, 1.f);
+			for (size_t i = 0; i < numPlayers; i++)
+			{
+				simulation.addPlayer("Player " + std::to_string(i));
+				simulation.setTurnSpeed(i, turn(random));
+			}
+			while (simulation.getNumCollectibles() < simulation.getMaxCollectibles())
+				simulation.enableCollectible();
+
+			simulation.start();
+			simulation.update(0.0);
+			const uint64_t stealsBefore = simulation.getJobs().getSteals();
+			const auto start = std::chrono::steady_clock::now();
+			for (unsigned i = 1; i <= numSteps; i++)
+			{
+				simulation.update(i / 60.0);
+				simulation.getPointEvents().clear();
+			}
+			const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			double checksum = 0.0;
+			for (size_t i = 0; i < simulation.getNumPlayers(); i++)
+			{
+				const glm::quat position = simulation.getPlayerStates().getPosition(i);
+				checksum += simulation.getPlayer(i).mPoints + position.x + position.y + position.z;
+			}
+			if (numThreads == 1)
+			{
+				serialTime = seconds;
+				serialChecksum = checksum;
+			}
+			isSame = isSame && checksum == serialChecksum;
+
+			Log::Info("Job scaling, %u threads: %.1f us per step, %.2fx speedup, %llu chunks stolen%s",
+				numThreads, 1e6 * seconds / numSteps, serialTime / seconds,
+				static_cast<unsigned long long>(simulation.getJobs().getSteals() - stealsBefore),
+				checksum == serialChecksum ? "" : ", RESULT DIFFERS FROM 1 THREAD");
+		}
+		return isSame;
+	}
+
+	//Grow a master from the [Game] capacities to numPlayers players and numCollectibles
+	//collectibles, step it for numSteps and decode every state message on a node. Logs the
+	//step and sync cost and returns whether the node ends up with the same entities in the
+	//same places
+	bool testScaling(size_t numPlayers, size_t numCollectibles, unsigned numSteps, unsigned seed,
+	                 size_t maxPlayers, size_t maxCollectibles)
+	{
+		ZoneScoped;
+		Simulation master;
+		master.init(maxPlayers, maxCollectibles, seed);
+		master.setTickRate(60.0, 1);
+		master.setSpawnRate(0.f);
+		master.setMaxTime(std::numeric_limits<float>::max());
+		Simulation node;
+		node.init(maxPlayers, maxCollectibles, seed);
+
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> turn(-1.f, 1.f);
+		for (size_t i = 0; i < numPlayers; i++)
+		{
+			master.addPlayer("bot" + std::to_string(i));
+			master.setTurnSpeed(i, turn(random));
+		}
+		for (size_t i = master.getNumCollectibles(); i < numCollectibles; i++)
+			master.enableCollectible();
+
+		StateSync masterSync, nodeSync;
+		masterSync.setRate(0.f);
+		nodeSync.setInterpolation(false, 0.0);
+		std::vector<std::byte> message;
+		size_t maxMessage = 0;
+		unsigned numRejected = 0;
+		double stepSeconds = 0.0, syncSeconds = 0.0;
+
+		master.start();
+		master.update(0.0);
+		for (unsigned i = 1; i <= numSteps; i++)
+		{
+			const double time = i / 60.0;
+			auto start = std::chrono::steady_clock::now();
+			master.update(time);
+			master.getPointEvents().clear();
+			stepSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			start = std::chrono::steady_clock::now();
+			message.clear();
+			masterSync.encode(master, message, time);
+			unsigned int pos = 0;
+			if (!nodeSync.decode(node, message, pos, time))
+				++numRejected;
+			nodeSync.interpolate(node, time);
+			syncSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			maxMessage = std::max(maxMessage, message.size());
+		}
+
+		//Quantized quaternions are within a few 1e-5 of the real ones
+		float maxError = 0.f;
+		const EntityStore& masterPlayers = master.getPlayerStates();
+		const EntityStore& nodePlayers = node.getPlayerStates();
+		for (size_t i = 0; i < std::min(master.getNumPlayers(), node.getNumPlayers()); i++)
+			maxError = std::max(maxError, 1.f - std::abs(glm::dot(masterPlayers.getPosition(i), nodePlayers.getPosition(i))));
+		const EntityStore& masterCollectibles = master.getCollectibleStates();
+		const EntityStore& nodeCollectibles = node.getCollectibleStates();
+		for (size_t i = 0; i < std::min(master.getNumCollectibles(), node.getNumCollectibles()); i++)
+			maxError = std::max(maxError, 1.f - std::abs(glm::dot(masterCollectibles.getPosition(i), nodeCollectibles.getPosition(i))));
+
+		const bool isSynced = numRejected == 0 && maxError < 1e-4f &&
+			node.getNumPlayers() == master.getNumPlayers() && node.getNumCollectibles() == master.getNumCollectibles();
+		Log::Info("Scaling to %zu players and %zu collectibles (capacities grown to %zu and %zu): "
+			"%.1f us per step, %.1f us per encode and decode, largest message %zu bytes",
+			master.getNumPlayers(), master.getNumCollectibles(), master.getMaxPlayers(), master.getMaxCollectibles(),
+			1e6 * stepSeconds / numSteps, 1e6 * syncSeconds / numSteps, maxMessage);
+		if (isSynced)
+			Log::Info("Scaling: node in sync with master");
+		else
+			Log::Error("Scaling: node out of sync, %u messages rejected, %zu/%zu players, %zu/%zu collectibles, "
+				"max position error %g", numRejected, node.getNumPlayers(), master.getNumPlayers(),
+				node.getNumCollectibles(), master.getNumCollectibles(), maxError);
+		return isSynced;
+	}
+
+	//Record numSteps steps of a session with virtual players, then run the collision test
+	//on every recorded step with the Euler angle box test Simulation used before, the scalar
+	//dot product kernel and the batch kernel. The batch kernel has to find exactly the hits
+	//of the scalar one. The old test is a box in angle space, it disagrees with the circle
+	//of the new one near the border only, the angles of those pairs are logged. Returns
+	//false if the batch kernel misses or adds a hit
+	bool verifyCollisionKernel(unsigned numSteps, unsigned seed, unsigned numPlayers, float inputRate,
+	                           size_t maxPlayers, size_t maxCollectibles)
+	{
+		ZoneScoped;
+		struct Frame
+		{
+			std::vector<glm::quat> mPlayers;
+			std::vector<glm::quat> mCollectibles;
+		};
+		std::vector<Frame> frames(numSteps);
+		{
+			Simulation simulation;
+			simulation.init(maxPlayers, maxCollectibles, seed);
+			simulation.setTickRate(60.0, 1);
+			simulation.setMaxTime(std::numeric_limits<float>::max());
+			LoadGenerator loadGenerator(numPlayers, inputRate, seed);
+			std::vector<InputMessage> messages;
+
+			simulation.start();
+			simulation.update(0.0);
+			for (unsigned step = 0; step < numSteps; step++)
+			{
+				const double time = (step + 1) / 60.0;
+				messages.clear();
+				loadGenerator.generate(time, messages);
+				for (const InputMessage& message : messages)
+					simulation.applyInput(message, 0);
+				simulation.update(time);
+				simulation.getPointEvents().clear();
+
+				Frame& frame = frames[step];
+				for (size_t i = 0; i < simulation.getNumPlayers(); i++)
+					frame.mPlayers.push_back(simulation.getPlayerStates().getPosition(i));
+				for (size_t j = 0; j < simulation.getNumCollectibles(); j++)
+					frame.mCollectibles.push_back(simulation.getCollectibleStates().getPosition(j));
+			}
+		}
+
+		//Hits of every frame as (player, collectible), in the order they are found
+		using Hits = std::vector<std::pair<uint32_t, uint32_t>>;
+		std::vector<glm::vec3> directions;
+		std::vector<uint32_t> near;
+
+		const float boxAngle = 0.1f;
+		SphereGrid boxGrid(2.f * boxAngle);
+		std::vector<Hits> boxHits(numSteps);
+		auto start = std::chrono::steady_clock::now();
+		for (unsigned step = 0; step < numSteps; step++)
+		{
+			const Frame& frame = frames[step];
+			directions.resize(frame.mCollectibles.size());
+			for (size_t j = 0; j < frame.mCollectibles.size(); j++)
+				directions[j] = SphereGrid::directionFromQuat(frame.mCollectibles[j]);
+			boxGrid.rebuild(directions);
+
+			for (size_t i = 0; i < frame.mPlayers.size(); i++)
+			{
+				const glm::quat inversePlayerQuat = glm::inverse(frame.mPlayers[i]);
+				boxGrid.forEachNear(SphereGrid::directionFromQuat(frame.mPlayers[i]), [&](size_t j)
+				{
+					const glm::quat deltaQuat = glm::normalize(inversePlayerQuat * frame.mCollectibles[j]);
+					const float xAngle = std::atan2(2.f * (deltaQuat.w * deltaQuat.x + deltaQuat.y * deltaQuat.z),
+						1.f - 2.f * (deltaQuat.x * deltaQuat.x + deltaQuat.y * deltaQuat.y));
+					const float yAngle = std::asin(2.f * (deltaQuat.w * deltaQuat.y - deltaQuat.z * deltaQuat.x));
+					if (std::abs(xAngle) <= boxAngle && std::abs(yAngle) <= boxAngle)
+						boxHits[step].emplace_back(static_cast<uint32_t>(i), static_cast<uint32_t>(j));
+				});
+			}
+		}
+		const double boxSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		const float angle = Simulation::mPLAYERCOLLISIONANGLE + Simulation::mCOLLECTIBLECOLLISIONANGLE;
+		const float cosAngle = std::cos(angle);
+		SphereGrid grid(angle);
+		auto runDot = [&](auto kernel, std::vector<Hits>& hits) {
+			const auto start = std::chrono::steady_clock::now();
+			for (unsigned step = 0; step < numSteps; step++)
+			{
+				const Frame& frame = frames[step];
+				directions.resize(frame.mCollectibles.size());
+				for (size_t j = 0; j < frame.mCollectibles.size(); j++)
+					directions[j] = SphereGrid::directionFromQuat(frame.mCollectibles[j]);
+				grid.rebuild(directions);
+				near.resize(grid.size());
+
+				for (size_t i = 0; i < frame.mPlayers.size(); i++)
+				{
+					const glm::vec3 direction = SphereGrid::directionFromQuat(frame.mPlayers[i]);
+					grid.forEachNearRange(direction, [&](size_t first, size_t last) {
+						const size_t numNear = kernel(direction, cosAngle, grid.getX(), grid.getY(), grid.getZ(),
+							grid.getItems(), first, last, near.data());
+						for (size_t n = 0; n < numNear; n++)
+							hits[step].emplace_back(static_cast<uint32_t>(i), near[n]);
+					});
+				}
+			}
+			return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		};
+		std::vector<Hits> scalarHits(numSteps), batchHits(numSteps);
+		const double scalarSeconds = runDot(&Integrator::collectNearScalar, scalarHits);
+		const double batchSeconds = runDot(&Integrator::collectNear, batchHits);
+
+		//Angle between the directions of a player and a collectible in a frame
+		auto pairAngle = [&frames](unsigned step, const std::pair<uint32_t, uint32_t>& hit) {
+			const glm::vec3 a = SphereGrid::directionFromQuat(frames[step].mPlayers[hit.first]);
+			const glm::vec3 b = SphereGrid::directionFromQuat(frames[step].mCollectibles[hit.second]);
+			return std::acos(std::clamp(glm::dot(a, b), -1.f, 1.f));
+		};
+
+		uint64_t numBatchMismatches = 0, numBoxHits = 0, numDotHits = 0, numShared = 0;
+		float minDisagreement = std::numeric_limits<float>::max(), maxDisagreement = 0.f;
+		for (unsigned step = 0; step < numSteps; step++)
+		{
+			if (batchHits[step] != scalarHits[step])
+				++numBatchMismatches;
+
+			std::sort(boxHits[step].begin(), boxHits[step].end());
+			Hits dotHits = scalarHits[step];
+			std::sort(dotHits.begin(), dotHits.end());
+			Hits disagreements;
+			std::set_symmetric_difference(boxHits[step].begin(), boxHits[step].end(), dotHits.begin(), dotHits.end(),
+				std::back_inserter(disagreements));
+			for (const std::pair<uint32_t, uint32_t>& hit : disagreements)
+			{
+				minDisagreement = std::min(minDisagreement, pairAngle(step, hit));
+				maxDisagreement = std::max(maxDisagreement, pairAngle(step, hit));
+			}
+			numBoxHits += boxHits[step].size();
+			numDotHits += dotHits.size();
+			numShared += (boxHits[step].size() + dotHits.size() - disagreements.size()) / 2;
+		}
+
+		Log::Info("Collision kernel over %u recorded steps: Euler angle box %.1f us per step, dot product "
+			"scalar %.1f us, %s %.1f us (%.2fx scalar, %.2fx box)", numSteps, 1e6 * boxSeconds / numSteps,
+			1e6 * scalarSeconds / numSteps, Integrator::simdName(), 1e6 * batchSeconds / numSteps,
+			scalarSeconds / batchSeconds, boxSeconds / batchSeconds);
+		Log::Info("Collision kernel hits: %llu box, %llu dot product, %llu in both, disagreements between "
+			"%.3f and %.3f rad apart", static_cast<unsigned long long>(numBoxHits),
+			static_cast<unsigned long long>(numDotHits), static_cast<unsigned long long>(numShared),
+			numBoxHits + numDotHits > 2 * numShared ? minDisagreement : 0.f, maxDisagreement);
+		if (numBatchMismatches > 0)
+			Log::Error("Collision kernel: %s hits differ from the scalar ones in %llu of %u steps",
+				Integrator::simdName(), static_cast<unsigned long long>(numBatchMismatches), numSteps);
+		return numBatchMismatches == 0;
+	}
+
+	//The master's work per frame, a step and the state encoding, at a quarter, half, three
+	//quarters and all of numPlayers players and numCollectibles collectibles. With the
+	//collision grid the cost per entity stays about the same, where the old double loop
+	//grew with the number of player and collectible pairs
+	void benchmarkBroadphase(size_t numPlayers, size_t numCollectibles, unsigned numSteps, unsigned seed)
+	{
+		ZoneScoped;
+		double firstCost = 0.0;
+		for (size_t quarter = 1; quarter <= 4; quarter++)
+		{
+			const size_t players = numPlayers * quarter / 4;
+			const size_t collectibles = numCollectibles * quarter / 4;
+			Simulation simulation;
+			simulation.init(players, collectibles, seed);
+			simulation.setTickRate(60.0, 1);
+			simulation.setMaxTime(std::numeric_limits<float>::max());
+
+			std::mt19937 random(seed);
+			std::uniform_real_distribution<float> turn(-1.f, 1.f);
+			for (size_t i = 0; i < players; i++)
+			{
+				simulation.addPlayer("bot" + std::to_string(i));
+				simulation.setTurnSpeed(i, turn(random));
+			}
+			while (simulation.getNumCollectibles() < collectibles)
+				simulation.enableCollectible();
+
+			StateSync stateSync;
+			stateSync.setRate(0.f);
+			std::vector<std::byte> message;
+			message.reserve(StateSync::maxMessageSize(players, collectibles));
+
+			simulation.start();
+			simulation.update(0.0);
+			const auto start = std::chrono::steady_clock::now();
+			for (unsigned i = 1; i <= numSteps; i++)
+			{
+				const double time = i / 60.0;
+				simulation.update(time);
+				simulation.getPointEvents().clear();
+				message.clear();
+				stateSync.encode(simulation, message, time);
+			}
+			const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			//Per entity, and relative to the smallest size, 1.0 means linear scaling
+			const double cost = seconds / numSteps / (players + collectibles);
+			if (quarter == 1)
+				firstCost = cost;
+			Log::Info("Broadphase, %zu players and %zu collectibles: %.1f us per frame, %.1f ns per entity "
+				"(%.2fx the smallest), %.2fx the pairs of the smallest", players, collectibles,
+				1e6 * seconds / numSteps, 1e9 * cost, cost / firstCost, static_cast<double>(quarter * quarter));
+		}
+	}
+
+	//A session of numFrames frames on a master and a node, the way main.cpp runs them: input
+	//from virtual players, a step, the state encoded into a reused buffer, copied into the
+	//node's staging buffer, decoded and interpolated. Every buffer has reached its size after
+	//warmupFrames, returns whether none of the frames after that allocated. Frames where the
+	//master or node grew their capacities allocate by design and are only counted
+	//Single threaded, the job queues allocate chunks as they fill
+	bool checkSyncAllocations(unsigned numFrames, unsigned warmupFrames, unsigned numPlayers, float inputRate,
+	                          float syncRate, bool isInterpolated, unsigned seed, size_t maxPlayers,
+	                          size_t maxCollectibles)
+	{
+		ZoneScoped;
+		Simulation master;
+		master.init(maxPlayers, maxCollectibles, seed);
+		master.setTickRate(60.0, 1);
+		master.setMaxTime(std::numeric_limits<float>::max());
+		Simulation node;
+		node.init(maxPlayers, maxCollectibles, seed);
+
+		StateSync masterSync, nodeSync;
+		masterSync.setRate(syncRate);
+		nodeSync.setRate(syncRate);
+		nodeSync.setInterpolation(isInterpolated, 0.25);
+		LoadGenerator loadGenerator(numPlayers, inputRate, seed);
+		std::vector<InputMessage> messages;
+		std::vector<std::byte> output;
+		std::vector<std::byte> stateMessage;
+		output.reserve(StateSync::maxMessageSize(maxPlayers, maxCollectibles));
+		stateMessage.reserve(output.capacity());
+
+		uint64_t warmupAllocations = 0, steadyAllocations = 0;
+		unsigned numAllocatingFrames = 0, numGrowingFrames = 0, numRejected = 0;
+		master.start();
+		master.update(0.0);
+		for (unsigned frame = 1; frame <= numFrames; frame++)
+		{
+			const uint64_t allocationsBefore = numAllocations;
+			const size_t capacitiesBefore = master.getMaxPlayers() + master.getMaxCollectibles() +
+				node.getMaxPlayers() + node.getMaxCollectibles();
+			const double time = frame / 60.0;
+			messages.clear();
+			loadGenerator.generate(time, messages);
+			for (const InputMessage& message : messages)
+				master.applyInput(message, 0);
+			master.update(time);
+			master.getPointEvents().clear();
+
+			output.clear();
+			masterSync.encode(master, output, time);
+			if (!output.empty())
+				master.getInputLatency().markSynced(InputLatency::now());
+			stateMessage.assign(output.begin(), output.end());
+			if (!stateMessage.empty())
+			{
+				unsigned int pos = 0;
+				if (!nodeSync.decode(node, stateMessage, pos, time))
+					++numRejected;
+			}
+			nodeSync.interpolate(node, time);
+
+			const uint64_t allocations = numAllocations - allocationsBefore;
+			const size_t capacities = master.getMaxPlayers() + master.getMaxCollectibles() +
+				node.getMaxPlayers() + node.getMaxCollectibles();
+			if (frame <= warmupFrames)
+			{
+				warmupAllocations += allocations;
+			}
+			else if (capacities != capacitiesBefore)
+			{
+				++numGrowingFrames;
+			}
+			else if (allocations > 0)
+			{
+				steadyAllocations += allocations;
+				++numAllocatingFrames;
+			}
+		}
+
+		Log::Info("Sync allocations over %u frames: %llu in the first %u, %llu after them, "
+			"%u frames grew the capacities", numFrames, static_cast<unsigned long long>(warmupAllocations),
+			warmupFrames, static_cast<unsigned long long>(steadyAllocations), numGrowingFrames);
+		if (numAllocatingFrames > 0 || numRejected > 0)
+			Log::Error("Sync allocations: %u frames after warm-up allocated, %u messages rejected",
+				numAllocatingFrames, numRejected);
+		return numAllocatingFrames == 0 && numRejected == 0;
+	}
+
+	//Step the same players numSteps times with the batch kernels of Integrator and with the
+	//scalar ones, for every number of players in sizes. Some players are disabled so that
+	//batches are partly masked, sizes that are not a multiple of the SIMD width end in the
+	//scalar tail. Logs the time per step of both and returns false if any position,
+	//orientation or model rotation ends up more than tolerance from the scalar one
+	bool verifyIntegrator(const std::vector<size_t>& sizes, unsigned numSteps, float tolerance, unsigned seed)
+	{
+		ZoneScoped;
+		const BallJointConstraint& constraint = Simulation::getConstraint();
+		const float deltaTime = 1.f / 60.f;
+		bool isPassed = true;
+		for (size_t numEntities : sizes)
+		{
+			EntityStore batch, scalar;
+			batch.reserve(numEntities);
+			scalar.reserve(numEntities);
+			std::mt19937 random(seed);
+			std::uniform_real_distribution<float> unit(-1.f, 1.f);
+			for (size_t i = 0; i < numEntities; i++)
+			{
+				//Scattered over the visible area, some of them near its edge
+				glm::quat position(glm::vec3(unit(random), unit(random), 0.f));
+				constraint.apply(position);
+				const float orientation = glm::pi<float>() * unit(random);
+				const glm::quat modelRotation(glm::pi<float>() * glm::vec3(unit(random), unit(random), unit(random)));
+				const float turnSpeed = unit(random);
+				const bool isEnabled = i % 7 != 3;
+				batch.add(position, orientation, modelRotation, 0.f, 1.f, Simulation::mDEFAULTSPEED, turnSpeed, isEnabled);
+				scalar.add(position, orientation, modelRotation, 0.f, 1.f, Simulation::mDEFAULTSPEED, turnSpeed, isEnabled);
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			for (unsigned step = 0; step < numSteps; step++)
+			{
+				Integrator::advancePlayers(batch, 0, numEntities, deltaTime, constraint);
+				Integrator::spinModels(batch, 0, numEntities, deltaTime);
+			}
+			const double batchSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			start = std::chrono::steady_clock::now();
+			for (unsigned step = 0; step < numSteps; step++)
+			{
+				Integrator::advancePlayersScalar(scalar, 0, numEntities, deltaTime, constraint);
+				Integrator::spinModelsScalar(scalar, 0, numEntities, deltaTime);
+			}
+			const double scalarSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			//Largest difference of any component
+			auto deviation = [](const glm::quat& a, const glm::quat& b) {
+				return std::max({ std::abs(a.w - b.w), std::abs(a.x - b.x), std::abs(a.y - b.y), std::abs(a.z - b.z) });
+			};
+			float maxDeviation = 0.f;
+			for (size_t i = 0; i < numEntities; i++)
+			{
+				maxDeviation = std::max({ maxDeviation,
+					deviation(batch.getPosition(i), scalar.getPosition(i)),
+					deviation(batch.getModelRotation(i), scalar.getModelRotation(i)),
+					std::abs(batch.mOrientations[i] - scalar.mOrientations[i]) });
+			}
+
+			Log::Info("Integrator, %zu players over %u steps: scalar %.1f us per step, %s %.1f us (%.2fx), "
+				"max deviation %g", numEntities, numSteps, 1e6 * scalarSeconds / numSteps, Integrator::simdName(),
+				1e6 * batchSeconds / numSteps, scalarSeconds / batchSeconds, maxDeviation);
+			if (!(maxDeviation <= tolerance))
+			{
+				Log::Error("Integrator: %s kernels deviate %g from the scalar ones with %zu players, more than %g",
+					Integrator::simdName(), maxDeviation, numEntities, tolerance);
+				isPassed = false;
+			}
+		}
+		return isPassed;
+	}
+} // namespace
+
+int main(int argc, char** argv)
+{
+	Ini appConfig;
+	try
+	{
+		appConfig = readIni(Utility::findRootDir() + "/config.ini");
+	}
+	catch (const std::runtime_error & e)
+	{
+		Log::Error("%s", e.what());
+		return EXIT_FAILURE;
+	}
+	IniGroup constraintConfig = appConfig["Constraint"];
+	Simulation::setConstraints(std::stof(constraintConfig["fov"]),
+	                           std::stof(constraintConfig["tilt"]));
+	IniGroup gameConfig = appConfig["Game"];
+	IniGroup syncConfig = appConfig["Sync"];
+	IniGroup benchConfig = appConfig["Bench"];
+	const unsigned seed = std::stoi(benchConfig["seed"]);
+	const size_t maxPlayers = std::stoi(gameConfig["maxPlayers"]);
+	const size_t maxCollectibles = std::stoi(gameConfig["maxCollectibles"]);
+
+	//Name, description and the case itself, returning false if a check failed
+	struct Case
+	{
+		const char* mName;
+		const char* mDescription;
+		std::function<bool()> mRun;
+	};
+	const std::vector<Case> cases{
+		{ "parse", "decode turn messages in the binary and text formats", [&]() {
+			benchmarkInputParsing(std::stoi(benchConfig["parseMessages"]), maxPlayers);
+			return true;
+		} },
+		{ "queue", "queue and drain storms of score messages from all players", [&]() {
+			benchmarkOutgoingQueue(std::stoi(benchConfig["queueStorms"]), maxPlayers);
+			return true;
+		} },
+		{ "jobs", "step a full game with 1 thread up to one per core", [&]() {
+			return benchmarkJobScaling(std::stoi(benchConfig["jobSteps"]), seed, maxPlayers, maxCollectibles);
+		} },
+		{ "scale", "grow a master far beyond the [Game] capacities with a node in sync", [&]() {
+			return testScaling(std::stoi(benchConfig["scalePlayers"]), std::stoi(benchConfig["scaleCollectibles"]),
+				600, seed, maxPlayers, maxCollectibles);
+		} },
+		{ "broadphase", "time a master frame at growing sizes up to broadphasePlayers and broadphaseCollectibles", [&]() {
+			benchmarkBroadphase(std::stoi(benchConfig["broadphasePlayers"]), std::stoi(benchConfig["broadphaseCollectibles"]),
+				std::stoi(benchConfig["broadphaseSteps"]), seed);
+			return true;
+		} },
+		{ "alloc", "check that encode, decode and interpolate do not allocate after warm-up", [&]() {
+			return checkSyncAllocations(std::stoi(benchConfig["allocFrames"]), std::stoi(benchConfig["allocWarmup"]),
+				std::stoi(benchConfig["allocPlayers"]), std::stof(benchConfig["allocInputRate"]),
+				std::stof(syncConfig["rate"]), syncConfig["interpolate"] == "true", seed, maxPlayers, maxCollectibles);
+		} },
+		{ "collision", "time the collision kernels on a recorded run and compare their hits", [&]() {
+			return verifyCollisionKernel(std::stoi(benchConfig["collisionSteps"]), seed,
+				std::stoi(benchConfig["collisionPlayers"]), std::stof(benchConfig["collisionInputRate"]),
+				maxPlayers, maxCollectibles);
+		} },
+		{ "integrator", "time the batch and scalar integrators and compare their results", [&]() {
+			std::vector<size_t> sizes;
+			std::istringstream iss(benchConfig["integratorSizes"]);
+			for (size_t size; iss >> size;)
+				sizes.push_back(size);
+			return verifyIntegrator(sizes, std::stoi(benchConfig["integratorSteps"]),
+				std::stof(benchConfig["integratorTolerance"]), seed);
+		} },
+	};
+
+	if (argc < 2)
+	{
+		std::string usage = "Usage: DomedagenBench <case>... | all";
+		for (const Case& c : cases)
+			usage += std::string("\n       ") + c.mName + " - " + c.mDescription;
+		Log::Info("%s", usage.c_str());
+		return EXIT_SUCCESS;
+	}
+
+	bool isPassed = true;
+	for (int arg = 1; arg < argc; arg++)
+	{
+		const std::string name = argv[arg];
+		bool isFound = false;
+		for (const Case& c : cases)
+		{
+			if (name != "all" && name != c.mName)
+				continue;
+
+			isFound = true;
+			Log::Info("Bench case %s", c.mName);
+			if (!c.mRun())
+			{
+				Log::Error("Bench case %s failed", c.mName);
+				isPassed = false;
+			}
+		}
+		if (!isFound)
+		{
+			Log::Error("Unknown bench case %s", name.c_str());
+			isPassed = false;
+		}
+	}
+	return isPassed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
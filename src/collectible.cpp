@@ -1,16 +1,10 @@
 #include "collectible.hpp"
 #include "constants.hpp"
+#include "integrator.hpp"
 
-Collectible::Collectible()
-	:Collectible{"can1"}
-{
-	setShaderData();
-}
-
-Collectible::Collectible(const std::string objectModelName)
-	:GameObject{ GameObject::COLLECTIBLE, DOMERADIUS, glm::vec3(1.f, 0.f, 0.f), 0.f, COLLECTIBLESCALE }
+Collectible::Collectible(EntityStore& store, size_t slot, const std::string objectModelName)
+	:GameObject{ store, slot, GameObject::COLLECTIBLE }
 	,GeometryHandler{ "collectible", objectModelName }
-	,mEnabled{false}, mNext{nullptr}
 {
 	setShaderData();
 }
@@ -18,42 +12,24 @@ Collectible::Collectible(const std::string objectModelName)
 Collectible::Collectible(const Collectible& src)
 	:GameObject{ src }, GeometryHandler{ src }
 {
-	mNext = src.mNext;
-	mEnabled = src.mEnabled;
 }
 
 Collectible::Collectible(Collectible&& src) noexcept
 	:GameObject{ std::move(src) }, GeometryHandler{ std::move(src) }
 {
-	mNext = src.mNext;
-	mEnabled = src.mEnabled;
 }
 
-Collectible& Collectible::operator=(const Collectible& src)
-{
-	auto copy = src;
-	std::swap(*this, copy);
-
-	return *this;
-}
-
-Collectible& Collectible::operator=(Collectible&& src) noexcept
+void Collectible::render(const glm::mat4& mvp, const glm::mat4& v) const
 {
-	GameObject::operator= (std::move(src));
-	GeometryHandler::operator= (std::move(src));
-	std::swap(mEnabled, src.mEnabled);
-	std::swap(mNext, src.mNext);
-
-	return *this;
+	render(mvp, v, glm::vec3((inverse(v))[3]));
 }
 
-void Collectible::render(const glm::mat4& mvp, const glm::mat4& v) const
+void Collectible::render(const glm::mat4& mvp, const glm::mat4& v, const glm::vec3& cameraPos) const
 {
-	glm::vec3 cameraPos = glm::vec3((inverse(v))[3]);
 	glUniform3fv(mCameraPosLoc, 1, glm::value_ptr(cameraPos));
 
-	glm::mat4 transformation = getTransformation();
-	glm::mat3 normalMatrix(glm::transpose(glm::inverse(transformation)));
+	const glm::mat4& transformation = getTransformation();
+	const glm::mat3& normalMatrix = getNormalMatrix();
 
 	glUniformMatrix3fv(mNormalMatrixLoc, 1, GL_FALSE, glm::value_ptr(normalMatrix));
 	glUniformMatrix4fv(mMvpMatrixLoc, 1, GL_FALSE, glm::value_ptr(mvp));
@@ -65,31 +41,5 @@ void Collectible::render(const glm::mat4& mvp, const glm::mat4& v) const
 
 void Collectible::update(float deltaTime)
 {
-	setModelRotation(getModelRotation() * glm::quat(deltaTime * 1.2f * glm::vec3(1.f, 1.f, 1.f)));
-}
-
-CollectibleData Collectible::getCollectibleData(unsigned index)
-{
-	CollectibleData temp;
-
-	temp.mModelIndex = getModelPointerIndex();
-
-	return temp;
-}
-
-void Collectible::setCollectibleData(const PositionData& newPosData, const int modelIndex)
-{
-	setPositionData(newPosData);
-	setModelFromInt(modelIndex);
-	enable();
-}
-
-void Collectible::setNext(Collectible* node)
-{
-	mNext = node;
-}
-
-Collectible* Collectible::getNext() const
-{
-	return mNext;
+	Integrator::spinModels(*mStore, mSlot, mSlot + 1, deltaTime);
 }
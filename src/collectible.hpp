@@ -3,55 +3,34 @@
 #include "gameobject.hpp"
 #include "geometryhandler.hpp"
 
-
-struct CollectibleData
-{
-	int mModelIndex;
-};
-
+//Render side of a collectible, a view on its slot in the Simulation collectible store
 class Collectible : public GameObject, private GeometryHandler
 {
 public:
 	//Give collectiblepool access to privates
 	friend class CollectiblePool;
-	Collectible();
-	//Ctor used to load all collectibles into vector in Game class
-	Collectible(const std::string objectModelName);
+	//View on slot of store, which Simulation::init allocated
+	Collectible(EntityStore& store, size_t slot, const std::string objectModelName);
 
-	//WARNING: these ctors might be leaky
-	//TODO These are not used anymore, remove?
+	//Copies are views on the same EntityStore slot
+	//Assignment is not allowed, the simulation swaps state in the store instead of objects
 	Collectible(const Collectible& src);
 	Collectible(Collectible&& src) noexcept;
-	Collectible& operator=(const Collectible& src);
-	Collectible& operator=(Collectible&& src) noexcept;
+	Collectible& operator=(const Collectible& src) = delete;
+	Collectible& operator=(Collectible&& src) = delete;
 	~Collectible() override = default;
 
 	//Inherited methods
 	void render(const glm::mat4& mvp, const glm::mat4& v) const override;
+	//Render with a camera position computed once per viewport by the caller
+	void render(const glm::mat4& mvp, const glm::mat4& v, const glm::vec3& cameraPos) const;
 	void update(float deltaTime) override;
 	void setSpeed(float speed) override {};
 
-	//Sync methods
-	CollectibleData getCollectibleData(unsigned index);
-	void setCollectibleData(const PositionData& newPosData, const int modelIndex);
-
-	//Set next node in list
-	void setNext(Collectible* node);
-
-	//Get next node
-	Collectible* getNext() const;
-
-	const bool isEnabled() const { return mEnabled; }
-private:
-	//Is this collectible active in the game?
-	bool mEnabled;
-
-	static constexpr float mSpeed = 0.1f;
+	//Model is the slot in ModelManager, follows Simulation::getCollectibleModel
+	int getModelIndex() const { return getModelPointerIndex(); }
+	void setModelIndex(int modelIndex) { setModelFromInt(modelIndex); }
 
-	//Pointer to implement free list functionality (constant time access!)
-	Collectible* mNext;
-	
-	void enable() { mEnabled = true; }
-	void disable() { mEnabled = false; }
+	const bool isEnabled() const { return mStore->mEnabled[mSlot] != 0; }
 };
 
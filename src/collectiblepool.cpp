@@ -1,104 +1,70 @@
 #include "collectiblepool.hpp"
 
-void CollectiblePool::init()
+#include <algorithm>
+
+void CollectiblePool::init(Simulation& simulation)
 {
 	ZoneScoped;
-	//Copy trash models from allModelNames
-	std::vector<std::string> trashModelNames;
-	for (const std::string& name : allModelNames)
-	{
-		if (name == "fish" || name == "diver" || name == "background")
-			continue;
+	EntityStore& states = simulation.getCollectibleStates();
+	for (size_t i = 0; i < simulation.getMaxCollectibles(); i++)
+		mPool.emplace_back(states, i, allModelNames[simulation.getCollectibleModel(i)]);
 
-		trashModelNames.push_back(name);
-	}
+	//Collectibles are only scaled uniformly, the shader derives normals from the transformation
+	const InstanceLayout layout{
+		{ { 3, 4, 0 }, { 4, 4, sizeof(glm::vec4) }, { 5, 4, 2 * sizeof(glm::vec4) }, { 6, 4, 3 * sizeof(glm::vec4) } },
+		sizeof(glm::mat4)
+	};
+	mInstances.init("collectibleinstanced", layout, mPool.size());
 
-	//Add objects to pool, set up list
-	for (size_t i = 0; i < mMAXNUMCOLLECTIBLES; i++)
-	{
-		Collectible tempCollectible{ Collectible(trashModelNames[i % trashModelNames.size()])
-		};
-		mPool.push_back(std::move(tempCollectible));
-	}
+	std::string sizeInfoString = std::to_string(mPool.size());
+	sgct::Log::Info("Collectible pool with %s elements created", sizeInfoString.c_str());
+}
 
-	//Set up pointer list
-	mFirstAvailable = &mPool[0];
-	for (size_t i = 0; i < mMAXNUMCOLLECTIBLES - 1; i++)
+void CollectiblePool::prepareRender(Simulation& simulation)
+{
+	ZoneScoped;
+	//The simulation ran out of slots and grew, the instance buffer grows on its own
+	EntityStore& states = simulation.getCollectibleStates();
+	for (size_t i = mPool.size(); i < simulation.getMaxCollectibles(); i++)
+		mPool.emplace_back(states, i, allModelNames[simulation.getCollectibleModel(i)]);
+
+	//Collectibles swap models when the simulation compacts its slots
+	mNumEnabled = std::min(simulation.getNumCollectibles(), mPool.size());
+	for (size_t i = 0; i < mNumEnabled; i++)
 	{
-		mPool[i].setNext(&mPool[i + 1]);
+		if (mPool[i].getModelIndex() != simulation.getCollectibleModel(i))
+			mPool[i].setModelIndex(simulation.getCollectibleModel(i));
 	}
-	mPool[mPool.size() - 1].setNext(nullptr);
 
-	std::string sizeInfoString = std::to_string(mPool.size());
-	sgct::Log::Info("Collectible pool with %s elements created", sizeInfoString.c_str());
+	//Transformations are computed once per frame here instead of once per viewport
+	simulation.getCollectibleStates().updateTransforms(0, mNumEnabled);
+
+	if (!mInstanced)
+		return;
+
+	mInstances.build(mNumEnabled,
+		[this](size_t i) { return mPool[i].getModelIndex(); },
+		[this](size_t i, glm::mat4& transformation) { transformation = mPool[i].getTransformation(); });
 }
 
 void CollectiblePool::render(const glm::mat4& mvp, const glm::mat4& v) const
 {
 	ZoneScoped;
+	if (mInstanced)
+	{
+		mInstances.render(mvp, v);
+		return;
+	}
+
 	if (mPool.size() > 0)
 	{
 		auto const& collectibleShader = mPool[0].mShaderProgram;
 		collectibleShader.bind();
+		const glm::vec3 cameraPos = glm::vec3((glm::inverse(v))[3]);
 		for (size_t i = 0; i < mNumEnabled; i++)
 		{
-			mPool[i].render(mvp, v);
+			mPool[i].render(mvp, v, cameraPos);
 		}
 		collectibleShader.unbind();
 	}
 }
-
-std::vector<CollectibleData> CollectiblePool::getPoolState()
-{
-	ZoneScoped;
-	std::vector<CollectibleData> poolData;
-	poolData.reserve(mNumEnabled);
-
-	for (size_t i = 0; i < mPool.size(); i++)
-	{
-		if (mPool[i].isEnabled())
-		{
-			poolData.push_back(mPool[i].getCollectibleData(i));
-		}
-	}
-
-	return poolData;
-}
-
-void CollectiblePool::enableCollectible(const glm::vec3& pos)
-{
-	ZoneScoped;
-	if (mFirstAvailable == nullptr)
-		return;
-
-	Collectible& newCollectible = *mFirstAvailable;
-	mFirstAvailable = newCollectible.getNext();
-
-	newCollectible.setPosition(pos);
-	newCollectible.enable();
-
-	++mNumEnabled;
-}
-
-void CollectiblePool::disableCollectibleAndSwap(const size_t index)
-{
-	ZoneScoped;
-	std::swap(mPool[index], mPool[mNumEnabled - 1]);
-
-	auto& lastEnabledElement = mPool[index];
-	auto& disabledElement = mPool[mNumEnabled - 1];
-
-	//Thread enabled object
-	lastEnabledElement.setNext(&mPool[index+1]);
-	if (index > 0)
-		mPool[index - 1].setNext(&lastEnabledElement);
-
-	//Rethread and prime disabled object for usage
-	disabledElement.disable();
-	disabledElement.setNext(mFirstAvailable);
-	if (mNumEnabled > 1)
-		mPool[mNumEnabled - 2].setNext(&disabledElement);	
-	mFirstAvailable = &disabledElement;
-
-	--mNumEnabled;
-}
\ No newline at end of file
@@ -1,66 +1,56 @@
 #pragma once
 
-#include <vector>
+#include <deque>
 
 #include "sgct/log.h"
 #include "sgct/shadermanager.h"
 #include "sgct/profiling.h"
 
 #include "collectible.hpp"
+#include "entitystore.hpp"
+#include "simulation.hpp"
+#include "instancebatch.hpp"
 #include "constants.hpp"
 
-//Contain all collectibles with object pool design pattern
+//Render side of the collectibles, one Collectible view per slot of the Simulation
+//collectible store. Which collectibles are enabled and their models are decided by the
+//Simulation, the pool only follows them once per frame in prepareRender()
 //Game contains an instance of this class
-//Pool is stable partitioned with enabled objects in front ACTUALLY this does not seem to be the case?
 class CollectiblePool
 {
 public:
-	//Ctor creates pool of mNumCollectibles collectibles
-	//Alternates between all trash models
-	//Points mFirstAvailable to first element	
 	CollectiblePool() = default;
 
-	//creates pool of mNumCollectibles collectibles
-	//Alternates between all trash models
-	//Points mFirstAvailable to first element	
-	void init();
+	//Create a view for every collectible of simulation, needs a GL context
+	void init(Simulation& simulation);
+
+	//Follow the enabled collectibles and models of simulation, then build and upload the
+	//per-instance data for this frame. Views are added for slots the simulation grew by
+	//Call once per frame after the state is final, before render() for any viewport
+	void prepareRender(Simulation& simulation);
 
 	//Render enabled objects
 	void render(const glm::mat4& mvp, const glm::mat4& v) const;
-	
-	//Get collectiblepool state
-	std::vector<CollectibleData> getPoolState();
-
-	//Returns shared_ptr and points mFirstAvailable to next in list. O(1)!
-	void enableCollectible(const glm::vec3& pos);
-
-	//Deactivates object at index and swaps to front (Used on master)
-	void disableCollectibleAndSwap(const size_t index);
 
-	//Simply deactivates element at index
-	void disableCollectible(const size_t index) { mPool[index].disable(); }
+	//Choose between one instanced draw per model and one draw per collectible
+	void setInstanced(bool instanced) { mInstanced = instanced; }
 
 	//Operator overloading to hide internal data
 	Collectible& operator[](const size_t i) { return mPool[i]; }
+	const Collectible& operator[](const size_t i) const { return mPool[i]; }
 
-	//Accessors/Mutator
+	//Number of collectibles drawn this frame
 	size_t getNumEnabled() const { return mNumEnabled; }
-	void setNumEnabled(size_t size) { mNumEnabled = size; }
-
-	//Max number of collectibles
-	static constexpr unsigned mMAXNUMCOLLECTIBLES = 300;
 
 private:
-	//The pool of collectible objects
-	std::vector<Collectible> mPool;
+	//The pool of collectible objects, views on the simulation collectible store
+	//A deque so adding views never moves the existing ones
+	std::deque<Collectible> mPool;
 
-	//Number of enabled objects
+	//Number of enabled objects, as of the last prepareRender()
 	size_t mNumEnabled = 0;
 
-	//Pointer to first available object ready to import into the game
-	Collectible* mFirstAvailable = nullptr;
-
-	//Limit on number of objects in pool
-	
-	
-};
\ No newline at end of file
+	//Instanced rendering, the transformation of each enabled collectible
+	bool mInstanced = true;
+	InstanceBatch<glm::mat4> mInstances;
+};
@@ -2,11 +2,15 @@
 
 #include <vector>
 #include <string>
+#include <utility>
 
 const std::vector<std::string> allModelNames{ "fish", "can1", "can2", "can3", "can4", "diver", "sixpack1", "sixpack2", "sixpack3", "background" };
 
 const std::vector<std::string> allShaderNames{ "player", "testing", "sceneobject", "background", "collectible"};
 
+//Instanced programs, their own vertex shader with the fragment shader of the per-object one
+const std::vector<std::pair<std::string, std::string>> instancedShaderNames{ { "collectibleinstanced", "collectible" }, { "playerinstanced", "player" } };
+
 constexpr float COLLECTIBLESCALE = 0.2f;
 constexpr float PLAYERSCALE = 0.5f;
 constexpr float DOMERADIUS = 7.4f;
\ No newline at end of file
@@ -0,0 +1,133 @@
+#include "entitystore.hpp"
+
+#include <utility>
+#include <algorithm>
+#include <initializer_list>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/quaternion.hpp>
+
+uint64_t EntityStore::mTransformsComputed = 0;
+
+size_t EntityStore::add(const glm::quat& position, float orientation, const glm::quat& modelRotation,
+                        float radius, float scale,
+                        float speed, float turnSpeed, bool enabled)
+{
+	mPosW.push_back(position.w);
+	mPosX.push_back(position.x);
+	mPosY.push_back(position.y);
+	mPosZ.push_back(position.z);
+
+	mRotW.push_back(modelRotation.w);
+	mRotX.push_back(modelRotation.x);
+	mRotY.push_back(modelRotation.y);
+	mRotZ.push_back(modelRotation.z);
+
+	mOrientations.push_back(orientation);
+	mSpeeds.push_back(speed);
+	mTurnSpeeds.push_back(turnSpeed);
+	mRadii.push_back(radius);
+	mScales.push_back(scale);
+	mEnabled.push_back(enabled ? 1 : 0);
+
+	mTransformations.emplace_back(1.f);
+	mNormalMatrices.emplace_back(1.f);
+	mDirty.push_back(1);
+	mNormalDirty.push_back(1);
+
+	return size() - 1;
+}
+
+void EntityStore::reserve(size_t n)
+{
+	for (auto* arr : { &mPosW, &mPosX, &mPosY, &mPosZ, &mRotW, &mRotX, &mRotY, &mRotZ,
+	                   &mOrientations, &mSpeeds, &mTurnSpeeds, &mRadii, &mScales })
+		arr->reserve(n);
+	mEnabled.reserve(n);
+	mTransformations.reserve(n);
+	mNormalMatrices.reserve(n);
+	mDirty.reserve(n);
+	mNormalDirty.reserve(n);
+}
+
+void EntityStore::swap(size_t a, size_t b)
+{
+	if (a == b)
+		return;
+
+	for (auto* arr : { &mPosW, &mPosX, &mPosY, &mPosZ, &mRotW, &mRotX, &mRotY, &mRotZ,
+	                   &mOrientations, &mSpeeds, &mTurnSpeeds, &mRadii, &mScales })
+		std::swap((*arr)[a], (*arr)[b]);
+	std::swap(mEnabled[a], mEnabled[b]);
+	std::swap(mTransformations[a], mTransformations[b]);
+	std::swap(mNormalMatrices[a], mNormalMatrices[b]);
+	std::swap(mDirty[a], mDirty[b]);
+	std::swap(mNormalDirty[a], mNormalDirty[b]);
+}
+
+void EntityStore::setPosition(size_t i, const glm::quat& q)
+{
+	mPosW[i] = q.w;
+	mPosX[i] = q.x;
+	mPosY[i] = q.y;
+	mPosZ[i] = q.z;
+	mDirty[i] = 1;
+}
+
+void EntityStore::setModelRotation(size_t i, const glm::quat& q)
+{
+	mRotW[i] = q.w;
+	mRotX[i] = q.x;
+	mRotY[i] = q.y;
+	mRotZ[i] = q.z;
+	mDirty[i] = 1;
+}
+
+void EntityStore::markDirty(size_t begin, size_t end)
+{
+	std::fill(mDirty.begin() + begin, mDirty.begin() + end, 1);
+}
+
+const glm::mat4& EntityStore::getTransformation(size_t i) const
+{
+	if (mDirty[i])
+		computeTransform(i);
+	return mTransformations[i];
+}
+
+const glm::mat3& EntityStore::getNormalMatrix(size_t i) const
+{
+	if (mDirty[i])
+		computeTransform(i);
+	if (mNormalDirty[i])
+	{
+		mNormalMatrices[i] = glm::mat3(glm::transpose(glm::inverse(mTransformations[i])));
+		mNormalDirty[i] = 0;
+	}
+	return mNormalMatrices[i];
+}
+
+void EntityStore::updateTransforms(size_t begin, size_t end) const
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		if (mDirty[i])
+			computeTransform(i);
+	}
+}
+
+void EntityStore::computeTransform(size_t i) const
+{
+	glm::mat4 trans    = glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.f, -mRadii[i]));
+	glm::mat4 orient   = glm::rotate(glm::mat4(1.f), mOrientations[i], glm::vec3(0, 0, 1));
+	glm::mat4 rot      = glm::toMat4(getPosition(i));
+	glm::mat4 scale    = glm::scale(glm::mat4(1.f), glm::vec3(mScales[i]));
+	glm::mat4 localRot = glm::toMat4(getModelRotation(i));
+
+	//TODO Put model rotation in a variable to allow models with different orientation
+	mTransformations[i] = rot * trans * orient * scale * localRot;
+	mDirty[i] = 0;
+	mNormalDirty[i] = 1;
+
+	++mTransformsComputed;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "glm/glm.hpp"
+#include <glm/gtc/quaternion.hpp>
+
+//Structure-of-arrays storage for the simulated state of game objects
+//GameObjects only keep a slot index into a store, the hot per-tick data lives here
+//Quaternion components are stored in separate arrays so that batch kernels can load
+//consecutive objects straight into SIMD registers
+//The store also caches the transformation and normal matrix of every slot. Mutators mark
+//a slot dirty, its transformation is recomputed on the next read or updateTransforms()
+//Normal matrices are only computed when read, the instanced shaders don't use them
+//Code writing the arrays directly has to call markDirty() itself
+class EntityStore
+{
+public:
+	EntityStore() = default;
+
+	//Stores are referenced by slot index from GameObjects, moving them would be an error
+	EntityStore(const EntityStore&) = delete;
+	EntityStore& operator=(const EntityStore&) = delete;
+
+	//Append a new slot and return its index
+	size_t add(const glm::quat& position, float orientation, const glm::quat& modelRotation,
+	           float radius, float scale,
+	           float speed = 0.f, float turnSpeed = 0.f, bool enabled = true);
+
+	//Reserve space for n slots in all arrays
+	void reserve(size_t n);
+
+	//Exchange the state of two slots
+	void swap(size_t a, size_t b);
+
+	size_t size() const { return mOrientations.size(); }
+
+	//Accessors
+	glm::quat getPosition(size_t i) const { return glm::quat(mPosW[i], mPosX[i], mPosY[i], mPosZ[i]); }
+	glm::quat getModelRotation(size_t i) const { return glm::quat(mRotW[i], mRotX[i], mRotY[i], mRotZ[i]); }
+
+	//Mutators
+	void setPosition(size_t i, const glm::quat& q);
+	void setModelRotation(size_t i, const glm::quat& q);
+	void setOrientation(size_t i, float orientation) { mOrientations[i] = orientation; mDirty[i] = 1; }
+	void setRadius(size_t i, float radius) { mRadii[i] = radius; mDirty[i] = 1; }
+	void setScale(size_t i, float scale) { mScales[i] = scale; mDirty[i] = 1; }
+
+	//Flag slots whose matrices have to be recomputed
+	void markDirty(size_t i) { mDirty[i] = 1; }
+	void markDirty(size_t begin, size_t end);
+
+	//Cached matrices of slot i, recomputed first if the slot is dirty
+	const glm::mat4& getTransformation(size_t i) const;
+	const glm::mat3& getNormalMatrix(size_t i) const;
+
+	//Recompute the transformations of all dirty slots in [begin, end)
+	//Called once per frame before rendering, so the draw calls of every viewport only read
+	void updateTransforms(size_t begin, size_t end) const;
+
+	//Number of transformations computed by all stores, for instrumentation
+	static uint64_t getTransformsComputed() { return mTransformsComputed; }
+
+	//Position on the sphere as a unit quaternion, one array per component
+	std::vector<float> mPosW, mPosX, mPosY, mPosZ;
+
+	//Rotation of the model applied before all other transformations
+	std::vector<float> mRotW, mRotX, mRotY, mRotZ;
+
+	//Orientation tangential to the sphere (radians), movement speed and turn speed
+	std::vector<float> mOrientations;
+	std::vector<float> mSpeeds;
+	std::vector<float> mTurnSpeeds;
+
+	//Radius of the sphere the object is positioned on and its uniform scale
+	std::vector<float> mRadii;
+	std::vector<float> mScales;
+
+	//Non-zero if the object takes part in the simulation (no vector<bool> bit packing)
+	std::vector<uint8_t> mEnabled;
+
+private:
+	//Transformation cache, contiguous per slot
+	mutable std::vector<glm::mat4> mTransformations;
+	mutable std::vector<glm::mat3> mNormalMatrices;
+	mutable std::vector<uint8_t> mDirty;
+	//Set when the transformation changed after the normal matrix was last computed
+	mutable std::vector<uint8_t> mNormalDirty;
+
+	static uint64_t mTransformsComputed;
+
+	void computeTransform(size_t i) const;
+};
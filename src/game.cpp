@@ -5,69 +5,31 @@ Game* Game::mInstance = nullptr;
 unsigned int Game::mUniqueId = 0;
 
 Game::Game()
-	: mMvp{ glm::mat4{1.f} }, mLastFrameTime{ -1 }, mLastSyncedPlayer{ 0 }
+	: mMvp{ glm::mat4{1.f} }
 {
 	for (const std::string& shaderName : allShaderNames)
 		loadShader(shaderName);
+	for (const std::pair<std::string, std::string>& shaderNames : instancedShaderNames)
+		loadShader(shaderNames.first, shaderNames.second);
 }
 
-void Game::detectCollisions()
-{
-	ZoneScoped;
-	if (mPlayers.size() > 0 && mCollectPool.getNumEnabled() > 0)
-	{
-		for (size_t i = 0; i < mPlayers.size(); i++)
-		{
-			glm::quat playerQuat = mPlayers[i].getPosition();
-			for (size_t j = 0; j < mCollectPool.getNumEnabled(); j++)
-			{
-				glm::quat collectibleQuat = mCollectPool[j].getPosition();
-				glm::quat deltaQuat = glm::normalize(glm::inverse(playerQuat) * collectibleQuat);
-
-				//Collision detection by comparing how small the angle between the objects are
-				//From https://en.wikipedia.org/wiki/Conversion_between_quaternions_and_Euler_angles
-				auto sinxPart = 2.f * (deltaQuat.w * deltaQuat.x + deltaQuat.y * deltaQuat.z);
-				auto cosxPart = 1.f - 2.f * (deltaQuat.x * deltaQuat.x + deltaQuat.y * deltaQuat.y);
-				auto xAngle = std::atan2(sinxPart, cosxPart);
-
-				auto sinyPart = 2.f * (deltaQuat.w * deltaQuat.y - deltaQuat.z * deltaQuat.x);
-				auto yAngle = std::asin(sinyPart);
-
-				if (std::abs(xAngle) <= collisionDistance && std::abs(yAngle) <= collisionDistance)
-				{
-					mPlayers[i].addPoints();
-                    mCollectPool.disableCollectibleAndSwap(j);
-                    mIdPoints.push_back(std::make_pair(i, mPlayers[i].getPoints()));
-				}
-			}			
-		}
-	}
-}
-
-void Game::spawnCollectibles(float currentFrameTime)
-{
-	if ((int)currentFrameTime % mPosGenerator.spawnTime == 0 && !mPosGenerator.hasSpawnedThisInterval)
-	{
-		for (size_t i = 0; i < mPlayers.size(); i++)
-		{
-			mCollectPool.enableCollectible(mPosGenerator.generatePos());
-		}
-		mPosGenerator.hasSpawnedThisInterval = true;
-	}
-
-	if ((int)currentFrameTime % mPosGenerator.spawnTime == 1)
-		mPosGenerator.hasSpawnedThisInterval = false;
-}
-
-void Game::init()
+void Game::init(size_t maxPlayers, size_t maxCollectibles)
 {
 	mInstance = new Game{};
-	mInstance->mIdPoints.reserve(mMAXPLAYERS);
 	mInstance->printLoadedAssets();
-	mInstance->mCollectPool.init();
-	mInstance->mPlayers.reserve(mMAXPLAYERS);	
-	mInstance->setBackground(new BackgroundObject());
-	mInstance->mPosGenerator.init();
+	mInstance->mSimulation.init(maxPlayers, maxCollectibles);
+	mInstance->mCollectPool.init(mInstance->mSimulation);
+	mInstance->mPlayerInstances.init("playerinstanced", InstanceLayout{
+		{ { 3, 4, offsetof(PlayerInstance, mTransformation) },
+		  { 4, 4, offsetof(PlayerInstance, mTransformation) + sizeof(glm::vec4) },
+		  { 5, 4, offsetof(PlayerInstance, mTransformation) + 2 * sizeof(glm::vec4) },
+		  { 6, 4, offsetof(PlayerInstance, mTransformation) + 3 * sizeof(glm::vec4) },
+		  { 7, 3, offsetof(PlayerInstance, mPrimaryColour) },
+		  { 8, 3, offsetof(PlayerInstance, mSecondaryColour) } },
+		sizeof(PlayerInstance)
+	}, maxPlayers);
+	mInstance->setBackground(new BackgroundObject(mInstance->mSceneStates));
+	sgct::Log::Info("Simulation kernels using %s", Integrator::simdName());
 }
 
 Game& Game::instance()
@@ -102,6 +64,61 @@ void Game::printLoadedAssets() const
 	mInstance->printShaderPrograms();
 }
 
+void Game::prepareRender()
+{
+	ZoneScoped;
+	const uint64_t computedBefore = EntityStore::getTransformsComputed();
+
+	//Views for players added to the simulation since last frame (new connections on
+	//master, roster data on nodes)
+	EntityStore& playerStates = mSimulation.getPlayerStates();
+	for (size_t i = mPlayers.size(); i < mSimulation.getNumPlayers(); i++)
+		mPlayers.emplace_back(playerStates, i, mSimulation.getPlayer(i).mColours);
+
+	//Matrices of everything that moved are computed here, once per frame, the draw calls
+	//of each viewport only read them from the EntityStore caches
+	playerStates.updateTransforms(0, playerStates.size());
+	mSceneStates.updateTransforms(0, mSceneStates.size());
+
+	if (mInstancedPlayers)
+	{
+		mPlayerInstances.build(mPlayers.size(),
+			[this](size_t i) { return mPlayers[i].isEnabled() ? mPlayers[i].getModelIndex() : -1; },
+			[this](size_t i, PlayerInstance& instance)
+			{
+				const Player& player = mPlayers[i];
+				instance.mTransformation = player.getTransformation();
+				instance.mPrimaryColour = player.getColours().first;
+				instance.mSecondaryColour = player.getColours().second;
+			});
+	}
+
+	mCollectPool.prepareRender(mSimulation);
+
+	const uint64_t computed = EntityStore::getTransformsComputed() - computedBefore;
+#ifdef TRACY_ENABLE
+	TracyPlot("Transforms computed", static_cast<int64_t>(computed));
+#endif
+	if (++mRenderFrames % 600 == 0)
+		sgct::Log::Info("Transforms computed this frame: %llu", static_cast<unsigned long long>(computed));
+}
+
+void Game::update()
+{
+	mSimulation.update(sgct::Engine::getTime());
+
+	const InputStaging::Counters& input = mSimulation.getInputCounters();
+#ifdef TRACY_ENABLE
+	TracyPlot("Input coalesced", static_cast<int64_t>(input.mCoalesced));
+	TracyPlot("Input dropped", static_cast<int64_t>(input.mDropped));
+#endif
+	if (++mUpdateFrames % 600 == 0)
+		sgct::Log::Info("Turn input this frame: %u received, %u coalesced, %u dropped, %u applied",
+			input.mReceived, input.mCoalesced, input.mDropped, input.mApplied);
+
+	mSimulation.getInputLatency().report(InputLatency::now());
+}
+
 void Game::render() const
 {
 	ZoneScoped;
@@ -117,73 +134,20 @@ void Game::render() const
 
 void Game::addPlayer()
 {
-	mPlayers.emplace_back();
+	mSimulation.addPlayer("temp", glm::quat(glm::vec3(0.f)), 0.f, 0.5f);
 	++mUniqueId;
 }
 
-void Game::addCollectible()
-{
-	mCollectPool.enableCollectible(mPosGenerator.generatePos());
-}
-
 void Game::addPlayer(const glm::vec3& pos)
 {
-	mPlayers.push_back(Player{ "diver", DOMERADIUS, pos, 0.f, "Player " + std::to_string(mUniqueId), 0.5 });
+	mSimulation.addPlayer("Player " + std::to_string(mUniqueId), glm::quat(pos), 0.f, 0.5f);
 	++mUniqueId;
 }
 
-void Game::addPlayer(const PlayerData& newPlayerData, const PositionData& newPosData)
-{
-	//Create player from PositionData object
-	mPlayers.emplace_back(newPlayerData, newPosData);
-}
-
 void Game::addPlayer(std::tuple<unsigned int, std::string>&& inputTuple)
 {
-	assert(std::get<0>(inputTuple) == mPlayers.size() && "Player creation desync (id out of bounds: mPlayers)");
-	mPlayers.emplace_back(std::get<1>(inputTuple), mPosGenerator.generatePos());
-}
-
-void Game::update()
-{
-	if (mGameIsStarted) {
-
-		ZoneScoped;
-		if (mGameIsEnded)
-			return;
-		if (mLastFrameTime == -1) //First update?
-		{
-			mLastFrameTime = static_cast<float>(sgct::Engine::getTime());
-			return;
-		}
-
-		float currentFrameTime = static_cast<float>(sgct::Engine::getTime());
-
-		float deltaTime = currentFrameTime - mLastFrameTime;
-		this->mTotalTime += deltaTime;
-		if (mTotalTime > mMaxTime && mGameIsStarted) {
-			this->endGame();
-		}
-
-		spawnCollectibles(currentFrameTime);
-
-		//Update players
-		for (auto& player : mPlayers)
-			player.update(deltaTime);
-
-		//for (size_t i = 0; i < CollectiblePool::mMAXNUMCOLLECTIBLES && mCollectPool[i].isEnabled(); i++)
-		for (size_t i = 0; i < CollectiblePool::mMAXNUMCOLLECTIBLES; i++)
-		{
-			mCollectPool[i].update(deltaTime);
-		}
-
-		//TODO Update other type of objects
-
-		detectCollisions();
-
-		mLastFrameTime = currentFrameTime;
-	}
-
+	assert(std::get<0>(inputTuple) == mSimulation.getNumPlayers() && "Player creation desync (id out of bounds: mPlayers)");
+	mSimulation.addPlayer(std::get<1>(inputTuple));
 }
 
 std::string Game::getLeaderboard() const
@@ -194,12 +158,13 @@ std::string Game::getLeaderboard() const
 	std::stringstream output;
 
 	std::vector<pointPair> sortedPlayersAndPoints;
-	sortedPlayersAndPoints.reserve(mPlayers.size());
+	sortedPlayersAndPoints.reserve(mSimulation.getNumPlayers());
 
 	//Make pairs of each players name and points
-	for (const auto& player : mPlayers)
+	for (size_t i = 0; i < mSimulation.getNumPlayers(); i++)
 	{
-		sortedPlayersAndPoints.push_back(std::make_pair(player.getName(), player.getPoints()));
+		const Simulation::PlayerInfo& player = mSimulation.getPlayer(i);
+		sortedPlayersAndPoints.push_back(std::make_pair(player.mName, player.mPoints));
 	}
 
 	//Sort decreasingly
@@ -222,207 +187,92 @@ std::string Game::getLeaderboard() const
 	return output.str();
 }
 
-void Game::sendPointsToServer(std::unique_ptr<WebSocketHandler>& ws)
-{
-	//Iterate over mIdPoints to get id's and new points
-	//Send these to server through ws
-    for (size_t i = 0; i < mIdPoints.size(); i++)
-    {
-        std::string playerId = std::to_string(mIdPoints[i].first);
-        std::string points = std::to_string(mIdPoints[i].second);
-        ws->queueMessage("P " + playerId + "   " + points);
-    }
-	mIdPoints.clear();
-}
-
-std::vector<SyncableData> Game::getSyncableData()
+void Game::sendUpdatesToServer(const std::function<void(const std::byte*, size_t)>& queueMessage)
 {
-	std::vector<SyncableData> tempData;
-	tempData.reserve(mCollectPool.getNumEnabled() * 1.5);
-
-	//Sync data for players present on all nodes first
-	for (size_t i = 0; i < mLastSyncedPlayer; ++i)
-	{
-		SyncableData tempState;
-		Player& currentPlayer = mPlayers[i];
-
-		tempState.mPlayerData = currentPlayer.getPlayerData(false);
-		tempState.mPositionData = currentPlayer.getPositionData();
-		tempState.mIsPlayer = true;
-
-		tempData.push_back(tempState);
-	}
-
-	//Players not present on client nodes needs some book keeping
-	for (size_t i = mLastSyncedPlayer; i < mPlayers.size(); ++i)
-	{
-		SyncableData tempState;
-		Player& currentPlayer = mPlayers[i];
-
-		tempState.mPlayerData = currentPlayer.getPlayerData(true);
-		tempState.mPositionData = currentPlayer.getPositionData();
-		tempState.mIsPlayer = true;
-
-		tempData.push_back(tempState);
-	}
-
-	//Get enabled collectibles
-	for (size_t i = 0; i < mCollectPool.getNumEnabled(); i++)
+	ZoneScoped;
+	if (!mRosterPending.empty())
 	{
-		SyncableData tempState;
-		Collectible& currentCollectible = mCollectPool[i];
-
-		tempState.mCollectData = currentCollectible.getCollectibleData(i);
-		tempState.mPositionData = currentCollectible.getPositionData();
-		tempState.mIsPlayer = false;
+		mRosterColours.clear();
+		for (unsigned id : mRosterPending)
+		{
+			if (id < mSimulation.getNumPlayers())
+				mRosterColours.emplace_back(id, mSimulation.getPlayer(id).mColours);
+			else
+				sgct::Log::Warning("Roster entry for unknown player %u", id);
+		}
+		mRosterPending.clear();
 
-		tempData.push_back(tempState);
+		ServerMessages::encodeRoster(mRosterColours, mServerMessage);
+		queueMessage(mServerMessage.data(), mServerMessage.size());
 	}
 
-	return tempData;
-}
-
-void Game::setSyncableData(const std::vector<SyncableData> newState) //Copy atm bc of sgct synchronocity issues
-{
-	if (newState.size() > 10000) //If this happens something got corrupt along the way
+	//Point events hold the new total of a player, so every score that changed is in there
+	std::vector<std::pair<unsigned, int>>& idPoints = mSimulation.getPointEvents();
+	const bool hasTime = mSimulation.isStarted() && !mSimulation.isEnded() && mSimulation.shouldSendTime();
+	if (idPoints.empty() && !hasTime)
 		return;
 
-	std::vector<SyncableData> newPlayerStates;
-	newPlayerStates.reserve(newState.size() / 2 + 1);
-  
-	std::vector<SyncableData> newCollectibleStates;
-	newCollectibleStates.reserve(newState.size() / 1.5 + 1);
-
-	size_t i = 0;
-	while (i < newState.size())
-	{
-		if (newState[i].mIsPlayer)
-			newPlayerStates.push_back(newState[i++]);
-		else
-			newCollectibleStates.push_back(newState[i++]);
-	}
-
-	if (newPlayerStates.size() > 0)
-		setDecodedPlayerData(newPlayerStates);
-	if (newCollectibleStates.size() > 0)
-		setDecodedCollectibleData(newCollectibleStates);	
-}
-
-void Game::startGame()
-{
-	this->mTotalTime = 0;
-	this->mGameIsStarted = true;
-}
-
-float Game::getPassedTime()
-{
-	float var = this->mTotalTime/this->mMaxTime;
-	float value = (int)(var * 100 + .5);
-	return (float)value / 100;
-}
-
-bool Game::shouldSendTime()
-{
-	if (mTotalTime - mLastTime > 1) {
-		mLastTime = mTotalTime;
-		return true;
-		
-	}
-	return false;
+	ServerMessages::encodeScoreboard(idPoints, hasTime, mSimulation.getPassedTime(), mServerMessage);
+	queueMessage(mServerMessage.data(), mServerMessage.size());
+	idPoints.clear();
 }
 
-void Game::setDecodedCollectibleData(const std::vector<SyncableData>& newState)
+void Game::renderPlayers() const
 {
-	mCollectPool.setNumEnabled(newState.size());
-	for (size_t i = 0; i < newState.size(); i++)
+	ZoneScoped;
+	if (mInstancedPlayers)
 	{
-		const SyncableData& currentState = newState[i];
-		mCollectPool[i].setCollectibleData(currentState.mPositionData, currentState.mCollectData.mModelIndex);
+		mPlayerInstances.render(mMvp, mV);
+		return;
 	}
 
-	//No need to disable any unactive elements as nodes only render
-}
-
-void Game::renderPlayers() const
-{
-	ZoneScoped;
 	if (mPlayers.size() > 0)
 	{
 		auto const& playerShader = sgct::ShaderManager::instance().shaderProgram("player");
 		playerShader.bind();
 
+		const glm::vec3 cameraPos = glm::vec3((glm::inverse(mV))[3]);
 		for (const Player& p : mPlayers)
-			p.render(mMvp, mV);
+			p.render(mMvp, mV, cameraPos);
 
 		playerShader.unbind();
 	}
 }
 
-void Game::setDecodedPlayerData(const std::vector<SyncableData>& newState)
-{
-	size_t nUnsyncedPlayers = mPlayers.size();
-
-	//New players get instanciated with correct value from the start
-	if (newState.size() > mPlayers.size())
-	{
-		for (size_t i = nUnsyncedPlayers; i < newState.size(); ++i)
-		{
-			addPlayer(newState[i].mPlayerData, newState[i].mPositionData);
-		}
-	}
-
-	for (size_t i = 0; i < nUnsyncedPlayers; ++i)
-	{
-		mPlayers[i].setPlayerData(newState[i].mPlayerData, newState[i].mPositionData);
-	}
-	nUnsyncedPlayers = mPlayers.size();	
-}
-
-void Game::updateTurnSpeed(std::tuple<unsigned int, float>&& input)
+void Game::stageTurnSpeed(unsigned id, float turnSpeed, uint32_t sequence, bool hasSequence,
+                          int64_t receiveTime)
 {
-	unsigned id = std::get<0>(input);
-	float rotAngle = std::get<1>(input);
-
-	assert(id < mPlayers.size() && "Player update turn speed desync (id out of bounds mPlayers");
-
-	mPlayers[id].setTurnSpeed(rotAngle);
+	//Unknown ids are counted as dropped when the input is applied
+	mSimulation.stageTurnSpeed(id, turnSpeed, sequence, hasSequence, receiveTime);
 }
 
 void Game::enablePlayer(unsigned id)
 {
-	assert(id < mPlayers.size() && "Player disable desync (id out of bounds mPlayers");
-	mPlayers[id].enablePlayer();
+	assert(id < mSimulation.getNumPlayers() && "Player disable desync (id out of bounds mPlayers");
+	mSimulation.setEnabled(id, true);
 }
 
 void Game::disablePlayer(unsigned id)
 {
-	assert(id < mPlayers.size() && "Player disable desync (id out of bounds mPlayers");
-	mPlayers[id].disablePlayer();
-}
-
-void Game::rotateAllPlayers(float newOrientation)
-{
-	for (auto& player : mPlayers)
-	{
-		player.setOrientation(player.getOrientation() + newOrientation);
-	}
+	assert(id < mSimulation.getNumPlayers() && "Player disable desync (id out of bounds mPlayers");
+	mSimulation.setEnabled(id, false);
 }
 
 std::pair<glm::vec3, glm::vec3> Game::getPlayerColours(unsigned id)
 {
-    assert(id < mPlayers.size() && "Player get colours desync (id out of bounds mPlayers");
-    return mPlayers[id].getColours();
+    assert(id < mSimulation.getNumPlayers() && "Player get colours desync (id out of bounds mPlayers");
+    return mSimulation.getPlayer(id).mColours;
 }
 
-void Game::loadShader(const std::string& shaderName)
+void Game::loadShader(const std::string& shaderName, const std::string& fragName)
 {
 	//Define path and strings to hold shaders
-	std::string path = Utility::findRootDir() + "/src/shaders/" + shaderName;
+	std::string path = Utility::findRootDir() + "/src/shaders/";
 	std::string vert, frag;
 
 	//Open streams to shader files
-	std::ifstream in_vert{ path + "vert.glsl" };
-	std::ifstream in_frag{ path + "frag.glsl" };
+	std::ifstream in_vert{ path + shaderName + "vert.glsl" };
+	std::ifstream in_frag{ path + (fragName.empty() ? shaderName : fragName) + "frag.glsl" };
 	
 	//Read shaders into strings
 	if (in_vert.good() && in_frag.good()) {
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <deque>
 #include <string>
 #include <fstream>
 #include <iostream>
@@ -10,6 +11,8 @@
 #include <cmath>
 #include <random>
 #include <cstddef>
+#include <algorithm>
+#include <functional>
 
 #include "sgct/shareddata.h"
 #include "sgct/log.h"
@@ -23,26 +26,21 @@
 
 #include "player.hpp"
 #include "collectiblepool.hpp"
+#include "simulation.hpp"
+#include "entitystore.hpp"
+#include "instancebatch.hpp"
 #include "utility.hpp"
 #include "backgroundobject.hpp"
-#include "websockethandler.h"
-
-//Because sgct can't handle syncting separate vectors all sync data gets put in one vector
-//This needs a master type to handle all syncable objects
-struct SyncableData
-{
-	PlayerData mPlayerData;
-	PositionData mPositionData;
-	CollectibleData mCollectData;
-	bool mIsPlayer;
-};
+#include "servermessages.hpp"
 
 //Implemented as explicit singleton, handles pretty much everything
+//The game rules and state are in mSimulation, Game adds the rendering on top
 class Game
 {
 public:
 	//Init instance and print useful shader and model info
-	static void init();
+	//Capacities are the initial ones, see Simulation::init
+	static void init(size_t maxPlayers, size_t maxCollectibles);
 
 	//Get instance
 	static Game& instance();
@@ -58,25 +56,32 @@ public:
 	//Print loaded assets (shaders, models)
 	void printLoadedAssets() const;
 
+	//Prepare per-frame render data (player views, matrices, instance buffers)
+	//Once per frame after the simulation state is final, before render()
+	void prepareRender();
+
 	//Render objects
 	void render() const;
 
+	//Draw players and collectibles instanced (one draw per model) or one by one
+	void setInstancing(bool instanced) { mInstancedPlayers = instanced; mCollectPool.setInstanced(instanced); }
+
 	//Set MVP matrix
 	void setMVP(const glm::mat4& mvp) { mMvp = mvp;};
 
 	//Set view matrix
 	void setV(const glm::mat4& v) { mV = v; }
 
+	//The game rules and simulated state, synchronised to the nodes by StateSync
+	Simulation& getSimulation() { return mSimulation; }
+	const Simulation& getSimulation() const { return mSimulation; }
+
 	//Used for debugging
 	void addPlayer();
-	void addCollectible();
+	void addCollectible() { mSimulation.enableCollectible(); }
 
 	void addPlayer(const glm::vec3& pos);
 
-	//Add player from playerdata for instant sync
-	void addPlayer(const PlayerData& newPlayerData,
-				   const PositionData& newPosData);
-
 	//Add player from server request
 	void addPlayer(std::tuple<unsigned int, std::string>&& inputTuple);
 
@@ -92,50 +97,84 @@ public:
 	std::string getLeaderboard() const;
 
 	//Check if game has ended
-	bool hasGameEnded() const { return mGameIsEnded; }
+	bool hasGameEnded() const { return mSimulation.isEnded(); }
 
 	//End the game (stop updating state)
-	void endGame() { mGameIsEnded = true; }
+	void endGame() { mSimulation.end(); }
 
 	//Set game time
-	void setMaxTime(float time) { mMaxTime = time; }
+	void setMaxTime(float time) { mSimulation.setMaxTime(time); }
+
+	//Fixed simulation step, see Simulation::setTickRate
+	void setTickRate(double rate, unsigned maxSteps) { mSimulation.setTickRate(rate, maxSteps); }
+	//Threads the simulation step is split over, see Simulation::setThreads
+	void setThreads(unsigned numThreads) { mSimulation.setThreads(numThreads); }
+	void setSpawnRate(float rate) { mSimulation.setSpawnRate(rate); }
 
 	//Update point data on phone
-	void sendPointsToServer(std::unique_ptr<WebSocketHandler>& ws);
+	//Send the colours of players added to the roster and a scoreboard with the scores that
+	//changed and the timer (once per second) to the server, see ServerMessages
+	//Nothing is sent if nothing changed. queueMessage takes each message, for the relay
+	//connection or the PhoneServer
+	void sendUpdatesToServer(const std::function<void(const std::byte*, size_t)>& queueMessage);
+
+	//Send the colours of player id in the next roster message
+	void addToRoster(unsigned id) { mRosterPending.push_back(id); }
 
 	//Set the turn speed of player player with id id
-	void updateTurnSpeed(std::tuple<unsigned int, float>&& input);
+	//Turn input from the phones, applied in the next update
+	void stageTurnSpeed(unsigned id, float turnSpeed, uint32_t sequence, bool hasSequence,
+	                    int64_t receiveTime = 0);
 
 	//DEBUGGING TOOL: apply orientation to all GameObjects
-	void rotateAllPlayers(float deltaOrientation);
+	void rotateAllPlayers(float deltaOrientation) { mSimulation.rotateAllPlayers(deltaOrientation); }
 
     //Get and return player-colours
     std::pair<glm::vec3, glm::vec3> getPlayerColours(unsigned id);
 
-	static constexpr size_t mMAXPLAYERS = 110;
-	static constexpr size_t mMAXCOLLECTIBLES = 300;
-
-	std::vector<SyncableData> getSyncableData();
-	void setSyncableData(const std::vector<SyncableData> newState);
-
 	//start timer
-	void startGame();
-	float getPassedTime();
-	bool shouldSendTime();
+	void startGame() { mSimulation.start(); }
+	float getPassedTime() const { return mSimulation.getPassedTime(); }
+	bool shouldSendTime() { return mSimulation.shouldSendTime(); }
 
 private:
 //Members
 	//Singleton instance of game
 	static Game* mInstance;
 
-	//All players stored sequentually
-	std::vector<Player> mPlayers;
+	//Players, collectibles and the rules of the game
+	Simulation mSimulation;
+
+	//State of objects that are not simulated (background)
+	EntityStore mSceneStates;
+
+	//Render views on the simulation players, mPlayers[i] is a view on slot i
+	//Created in prepareRender() for players the simulation has added since, a deque so
+	//adding views never moves the existing ones
+	std::deque<Player> mPlayers;
+
+	//Per-instance data of an enabled player for instanced rendering
+	struct PlayerInstance
+	{
+		glm::mat4 mTransformation;
+		glm::vec3 mPrimaryColour;
+		glm::vec3 mSecondaryColour;
+	};
+	InstanceBatch<PlayerInstance> mPlayerInstances;
+	bool mInstancedPlayers = true;
+
+	//Frames prepared for rendering and simulated, pace the periodic logs
+	unsigned mRenderFrames = 0;
+	unsigned mUpdateFrames = 0;
 
 	//Pool of collectibles for fast "generation" of objects
 	CollectiblePool mCollectPool;
 
-	//Has the game ended?
-	bool mGameIsEnded = false;
+	//Players whose colours have not been sent to the server yet
+	std::vector<unsigned> mRosterPending;
+	//Scratch space for sendUpdatesToServer, kept to avoid allocating every frame
+	std::vector<std::pair<unsigned, std::pair<glm::vec3, glm::vec3>>> mRosterColours;
+	std::vector<std::byte> mServerMessage;
 
 	//GameObjects unique id generator for player tagging
 	//Deprecated
@@ -144,48 +183,23 @@ private:
 	//Track all loaded shaders' names
 	std::vector<std::string> mShaderNames;
 
-	//Container to store player id and new points
-	//Data sent to server to update score on each player's phone
-	std::vector<std::pair<unsigned, int>> mIdPoints;
-
 	//MVP matrix used for rendering
 	glm::mat4 mMvp;
 
 	//View matrix
 	glm::mat4 mV;
 
-	//Slot after which players only present on master node exist
-	size_t mLastSyncedPlayer;
-
-	//The time of the last update (in seconds)
-	float mLastFrameTime;
-
-	static constexpr double collisionDistance = 0.1f; //TODO make this object specific
-
 	BackgroundObject *mBackground; //Holds pointer to the background
 
-	float mTotalTime = 0, mMaxTime = 60;//seconds
-	float mLastTime = 0;
-	bool mGameIsStarted = false;
-
 //Functions
 	//Constructor
 	Game();
 
-	//Collision detection in mInteractObjects, bubble style
-	void detectCollisions();
-
-	//Spawn Collectibles
-	void spawnCollectibles(float currentFrameTime);
-
-	//Set object data from inputted data
-	void setDecodedPlayerData(const std::vector<SyncableData>& newState);
-	void setDecodedCollectibleData(const std::vector<SyncableData>& newState);
-
 	void renderPlayers() const;
 
 	//Read shader into ShaderManager
-	void loadShader(const std::string& shaderName);
+	//The fragment shader is fragName's if given, so programs can share one
+	void loadShader(const std::string& shaderName, const std::string& fragName = "");
 
 	//Set background
 	void setBackground(BackgroundObject* background){
@@ -197,29 +211,4 @@ private:
 
 	const glm::mat4& getMVP() { return mMvp; };
 	const glm::mat4& getV() { return mV; };
-
-	struct PositionGenerator
-	{
-		void init()
-		{
-			std::random_device randomDevice;
-			gen = std::mt19937(randomDevice());
-			rng = std::uniform_real_distribution<>(-1.5f, 1.5f);
-		}
-
-		//RNG stuff
-		std::mt19937 gen;
-		std::uniform_real_distribution<> rng;
-
-		//State stuff
-		bool hasSpawnedThisInterval = false;
-		unsigned spawnTime = 4;
-
-		glm::vec3 generatePos()
-		{
-			ZoneScoped;
-			return glm::vec3(1.5f + rng(gen), rng(gen), 0.f);
-		}
-
-	} mPosGenerator;
 };
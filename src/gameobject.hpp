@@ -12,30 +12,12 @@
 #include "glad/glad.h"
 
 #include "renderable.hpp"
-
-struct PositionData
-{
-public:
-	//TODO all of this data might not be needed to send
-	float mRadius;
-	float mOrientation;
-	float mScale;
-
-	//Model rotation stuff
-	float mModelW;
-	float mModelX;
-	float mModelY;
-	float mModelZ;
-
-	//Quat stuff
-	float mW;
-	float mX;
-	float mY;
-	float mZ;
-};
+#include "entitystore.hpp"
 
 //A GameObject is located att the surface of a sphere
 //and it has a side that is always facing origin.
+//Position, orientation and model rotation live in an EntityStore slot, the object itself
+//only holds a view on that slot plus render-side data
 class GameObject : public Renderable
 {
 public:
@@ -50,17 +32,21 @@ public:
 	GameObject() = delete;
 	GameObject(const GameObject&) = default;
 	GameObject(GameObject&&) = default;
-	GameObject& operator=(const GameObject&) = default;
-	GameObject& operator=(GameObject&& src) noexcept;
+	GameObject& operator=(const GameObject&) = delete;
+	GameObject& operator=(GameObject&&) = delete;
 
-	//Ctor
-	GameObject(const unsigned objType,
+	//Ctor, allocates a new slot in store
+	GameObject(EntityStore& store,
+	           const unsigned objType,
 	           float radius,
 	           const glm::quat& position,
 	           float orientation,
 			   float scale,
 	           const glm::quat& modelRotation = glm::quat(glm::vec3(glm::half_pi<float>(), 0.f, glm::pi<float>())));
 
+	//Ctor, view on a slot that already exists in store
+	GameObject(EntityStore& store, size_t slot, const unsigned objType);
+
 
 	//Dtor implemented by subclasses
 	virtual ~GameObject() override = default;
@@ -75,42 +61,33 @@ public:
 	virtual void setSpeed(float speed) = 0;
 	virtual void setTurnSpeed(float) {};
 
-	//Calculates and returns the objects transformation matrix
-	glm::mat4 getTransformation() const; // is there any reason for this not returning const&?
+	//Transformation and normal matrix, cached in the EntityStore until the state changes
+	const glm::mat4& getTransformation() const { return mStore->getTransformation(mSlot); }
+	const glm::mat3& getNormalMatrix() const { return mStore->getNormalMatrix(mSlot); }
 
 	//Accessors
-	const float getScale() const { return mScale; }
-	const float getRadius() const { return mRadius; }
+	const float getScale() const { return mStore->mScales[mSlot]; }
+	const float getRadius() const { return mStore->mRadii[mSlot]; }
 	unsigned getObjType() const { return mObjType; }
-	const glm::quat& getPosition() const { return mPosition; }
-	const glm::quat& getModelRotation() const { return mModelRotation; }
-	const float getOrientation() const { return mOrientation; }
-	const PositionData getPositionData() const;	
+	glm::quat getPosition() const { return mStore->getPosition(mSlot); }
+	glm::quat getModelRotation() const { return mStore->getModelRotation(mSlot); }
+	const float getOrientation() const { return mStore->mOrientations[mSlot]; }
+	size_t getSlot() const { return mSlot; }
 
 	//Mutators
-	void setRadius(float radius) { mRadius = radius; }
-	void setScale(float scale) { mScale = scale; }
-	void setPosition(const glm::quat position) { mPosition = position; }
-	void setModelRotation(const glm::quat& modelRotation) { mModelRotation = modelRotation; }
-	void setOrientation(float orientation) { mOrientation = orientation; }
-	void setPositionData(const PositionData& newPosition);
+	void setRadius(float radius) { mStore->setRadius(mSlot, radius); }
+	void setScale(float scale) { mStore->setScale(mSlot, scale); }
+	void setPosition(const glm::quat position) { mStore->setPosition(mSlot, position); }
+	void setModelRotation(const glm::quat& modelRotation) { mStore->setModelRotation(mSlot, modelRotation); }
+	void setOrientation(float orientation) { mStore->setOrientation(mSlot, orientation); }
+
+protected:
+	//Store holding the simulated state of this object and the slot in it
+	//Position is a unit quaternion, orientation is in radians tangential to the sphere
+	EntityStore* mStore;
+	size_t mSlot;
 
 private:
-	//The position on the sphere represented by a unit quaternion
-	glm::quat mPosition;
-
-	//The radius of the sphere the object is positioned on
-	float mRadius;
-
-	//Rotation of model, i.e. rotation applied before all other transformations
-	glm::quat mModelRotation;
-
-	//The orientation in radians of the object (tangential to sphere)
-	float mOrientation;
-
-	//Scale of object, uniform
-	float mScale;
-
 	//Lightweight representation of object type
 	unsigned const mObjType;
 };
\ No newline at end of file
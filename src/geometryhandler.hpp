@@ -27,11 +27,11 @@ public:
 	~GeometryHandler() { mModel = nullptr; }
 
 	//Get model pointer index
-	int getModelPointerIndex(){return mModelSlot;}
+	int getModelPointerIndex() const {return mModelSlot;}
 
 	//Set new model from slot index in ModelManager
 	void setModelFromInt(const int index)
-	{mModel = &ModelManager::instance().getModel(index);}
+	{mModel = &ModelManager::instance().getModel(index); mModelSlot = index;}
 	
 	//Shader matrix locations
 	GLint mTransMatrixLoc = -1;
@@ -0,0 +1,87 @@
+#include "handlepool.hpp"
+
+#include <cassert>
+
+void HandlePool::init(size_t capacity)
+{
+	//Generations carry on, so handles of a previous init don't become valid again
+	const size_t oldCapacity = mSlots.size();
+	mSlots.resize(capacity);
+	for (size_t slot = 0; slot < capacity; slot++)
+	{
+		mSlots[slot].mIndex = UINT32_MAX;
+		if (slot < oldCapacity)
+			++mSlots[slot].mGeneration;
+	}
+
+	mDenseSlots.clear();
+	mDenseSlots.reserve(capacity);
+
+	//Lowest slots first
+	mFreeSlots.resize(capacity);
+	for (size_t i = 0; i < capacity; i++)
+		mFreeSlots[i] = static_cast<uint32_t>(capacity - 1 - i);
+}
+
+void HandlePool::grow(size_t capacity)
+{
+	const size_t oldCapacity = mSlots.size();
+	if (capacity <= oldCapacity)
+		return;
+
+	mSlots.resize(capacity);
+	mDenseSlots.reserve(capacity);
+
+	//The new slots go below the free ones, lowest first
+	mFreeSlots.insert(mFreeSlots.begin(), capacity - oldCapacity, 0);
+	for (size_t i = 0; i < capacity - oldCapacity; i++)
+		mFreeSlots[i] = static_cast<uint32_t>(capacity - 1 - i);
+}
+
+HandlePool::Handle HandlePool::add()
+{
+	if (mFreeSlots.empty())
+		return Handle{};
+
+	const uint32_t slot = mFreeSlots.back();
+	mFreeSlots.pop_back();
+	mSlots[slot].mIndex = static_cast<uint32_t>(mDenseSlots.size());
+	mDenseSlots.push_back(slot);
+	return Handle{ slot, mSlots[slot].mGeneration };
+}
+
+size_t HandlePool::removeAt(size_t index)
+{
+	assert(index < mDenseSlots.size() && "Removing a dense index that is not live");
+	const size_t last = mDenseSlots.size() - 1;
+	const uint32_t removedSlot = mDenseSlots[index];
+
+	//The last live object takes the hole
+	const uint32_t movedSlot = mDenseSlots[last];
+	mDenseSlots[index] = movedSlot;
+	mSlots[movedSlot].mIndex = static_cast<uint32_t>(index);
+	mDenseSlots.pop_back();
+
+	//Outstanding handles of the removed object go stale
+	mSlots[removedSlot].mIndex = UINT32_MAX;
+	++mSlots[removedSlot].mGeneration;
+	mFreeSlots.push_back(removedSlot);
+	return last;
+}
+
+size_t HandlePool::indexOf(Handle handle) const
+{
+	if (handle.mSlot >= mSlots.size())
+		return npos;
+
+	const Slot& slot = mSlots[handle.mSlot];
+	if (slot.mGeneration != handle.mGeneration || slot.mIndex == UINT32_MAX)
+		return npos;
+	return slot.mIndex;
+}
+
+HandlePool::Handle HandlePool::handleAt(size_t index) const
+{
+	const uint32_t slot = mDenseSlots[index];
+	return Handle{ slot, mSlots[slot].mGeneration };
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+//Generational handles for objects stored densely in parallel arrays (EntityStore slots)
+//Live objects are always the first size() dense indices. Removing one moves the last
+//live object into the hole, the pool only tracks which handle sits at which index, the
+//caller moves its own data the same way. Handles stay valid across these moves and go
+//stale when their object is removed, even if the slot is reused afterwards
+class HandlePool
+{
+public:
+	struct Handle
+	{
+		uint32_t mSlot = UINT32_MAX;
+		uint32_t mGeneration = 0;
+
+		bool operator==(const Handle& other) const
+		{
+			return mSlot == other.mSlot && mGeneration == other.mGeneration;
+		}
+		bool operator!=(const Handle& other) const { return !(*this == other); }
+	};
+
+	static constexpr size_t npos = SIZE_MAX;
+
+	//Room for capacity live objects, all handles from before are invalidated
+	void init(size_t capacity);
+	//Room for capacity live objects, live handles stay valid
+	void grow(size_t capacity);
+
+	//Take dense index size() for a new object and return its handle
+	//Returns an invalid handle if the pool is full
+	Handle add();
+
+	//Remove the object at dense index index, the last live object moves there
+	//Returns the index it moved from (size() after the call), equal to index if it was last
+	size_t removeAt(size_t index);
+
+	//Dense index of handle, npos if it was removed or never valid
+	size_t indexOf(Handle handle) const;
+	bool isValid(Handle handle) const { return indexOf(handle) != npos; }
+	//Handle of the object at dense index index < size()
+	Handle handleAt(size_t index) const;
+
+	size_t size() const { return mDenseSlots.size(); }
+	size_t capacity() const { return mSlots.size(); }
+
+private:
+	struct Slot
+	{
+		uint32_t mIndex = UINT32_MAX;
+		uint32_t mGeneration = 0;
+	};
+
+	//Sparse table, indexed by Handle::mSlot
+	std::vector<Slot> mSlots;
+	//Slot of each live dense index
+	std::vector<uint32_t> mDenseSlots;
+	//Unused slots, taken from the back
+	std::vector<uint32_t> mFreeSlots;
+};
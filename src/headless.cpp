@@ -0,0 +1,172 @@
+//
+//  Headless master: runs the simulation and the state sync encoding without SGCT
+//  windows or OpenGL, fed by LoadGenerator instead of phones. For profiling master
+//  throughput on machines without a GPU
+//
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cstdlib>
+
+#include "sgct/log.h"
+#include "sgct/profiling.h"
+
+#include "utility.hpp"
+#include "inireader.h"
+#include "simulation.hpp"
+#include "statesync.hpp"
+#include "loadgenerator.hpp"
+#include "inputprotocol.hpp"
+#include "messagering.hpp"
+#include "servermessages.hpp"
+
+using namespace sgct;
+
+int main(int, char**)
+{
+	Ini appConfig;
+	try
+	{
+		appConfig = readIni(Utility::findRootDir() + "/config.ini");
+	}
+	catch (const std::runtime_error & e)
+	{
+		Log::Error("%s", e.what());
+		return EXIT_FAILURE;
+	}
+	IniGroup constraintConfig = appConfig["Constraint"];
+	Simulation::setConstraints(std::stof(constraintConfig["fov"]),
+	                           std::stof(constraintConfig["tilt"]));
+	IniGroup gameConfig = appConfig["Game"];
+	IniGroup syncConfig = appConfig["Sync"];
+	IniGroup headlessConfig = appConfig["Headless"];
+	const unsigned numPlayers = std::stoi(headlessConfig["players"]);
+	const double tickRate = std::stod(headlessConfig["tickRate"]);
+	const float inputRate = std::stof(headlessConfig["inputRate"]);
+	const unsigned seed = std::stoi(headlessConfig["seed"]);
+	const bool binaryInput = headlessConfig["inputFormat"] != "text";
+	const bool isRealtime = headlessConfig["realtime"] == "true";
+	const size_t maxPlayers = std::stoi(gameConfig["maxPlayers"]);
+	const size_t maxCollectibles = std::stoi(gameConfig["maxCollectibles"]);
+
+	//Same capacities as the windowed master
+	Simulation simulation;
+	simulation.init(maxPlayers, maxCollectibles, seed);
+	simulation.setMaxTime(std::stof(gameConfig["maxTime"]));
+	simulation.setTickRate(std::stod(gameConfig["tickRate"]), std::stoi(gameConfig["maxSteps"]));
+	simulation.setThreads(std::stoi(gameConfig["threads"]));
+	simulation.setSpawnRate(std::stof(gameConfig["spawnRate"]));
+
+	StateSync stateSync;
+	stateSync.setRate(std::stof(syncConfig["rate"]));
+
+	LoadGenerator loadGenerator(numPlayers, inputRate, seed);
+	std::vector<InputMessage> messages;
+	std::vector<std::byte> binaryMessage;
+	std::string textMessage;
+	std::vector<std::byte> output;
+	MessageRing serverMessages(64 * 1024, 16);
+	std::vector<std::byte> serverMessage;
+	uint64_t numServerMessages = 0;
+	output.reserve(StateSync::maxMessageSize(maxPlayers, maxCollectibles));
+
+	Log::Info("Headless run: %u players, %.0f ticks/s, %.1f %s inputs/s per player, seed %u",
+		numPlayers, tickRate, inputRate, binaryInput ? "binary" : "text", seed);
+
+	//Simulated time advances a fixed step per tick, the run goes as fast as it can
+	simulation.start();
+	const double deltaTime = 1.0 / tickRate;
+	double time = 0.0;
+	uint64_t ticks = 0, pointEvents = 0, serverBatches = 0, serverBytes = 0;
+	uint64_t inputCoalesced = 0, inputDropped = 0;
+	double totalTickTime = 0.0, maxTickTime = 0.0;
+	while (!simulation.isEnded())
+	{
+		const auto tickStart = std::chrono::steady_clock::now();
+		{
+			ZoneScopedN("Headless tick");
+			messages.clear();
+			loadGenerator.generate(time, messages);
+			//Round trip through the wire format so decoding is part of the tick
+			//Stamped like the web server does, the relay stage only covers the encoding
+			for (InputMessage generated : messages)
+			{
+				generated.mRelayTime = InputLatency::now();
+				InputMessage message;
+				bool isValid;
+				if (binaryInput)
+				{
+					InputProtocol::encodeBinary(generated, binaryMessage);
+					isValid = InputProtocol::decode(binaryMessage.data(), binaryMessage.size(), message);
+				}
+				else
+				{
+					InputProtocol::encodeText(generated, textMessage);
+					isValid = InputProtocol::decode(textMessage.data(), textMessage.size(), message);
+				}
+				if (isValid)
+					simulation.applyInput(message, InputLatency::now());
+			}
+
+			simulation.update(time);
+			const InputStaging::Counters& input = simulation.getInputCounters();
+			inputCoalesced += input.mCoalesced;
+			inputDropped += input.mDropped;
+
+			//Stands in for Game::sendUpdatesToServer and one service cycle of WebSocketHandler
+			std::vector<std::pair<unsigned, int>>& idPoints = simulation.getPointEvents();
+			const bool hasTime = !simulation.isEnded() && simulation.shouldSendTime();
+			if (!idPoints.empty() || hasTime)
+			{
+				ServerMessages::encodeScoreboard(idPoints, hasTime, simulation.getPassedTime(), serverMessage);
+				serverMessages.push(serverMessage.data(), serverMessage.size());
+				++numServerMessages;
+			}
+			pointEvents += idPoints.size();
+			idPoints.clear();
+			size_t batchSize;
+			if (serverMessages.frontBatch(batchSize))
+			{
+				serverBytes += batchSize;
+				++serverBatches;
+				serverMessages.popBatch();
+			}
+
+			output.clear();
+			stateSync.encode(simulation, output, time);
+			if (!output.empty())
+				simulation.getInputLatency().markSynced(InputLatency::now());
+			simulation.getInputLatency().report(InputLatency::now());
+		}
+		FrameMark;
+
+		const double tickTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - tickStart).count();
+		totalTickTime += tickTime;
+		maxTickTime = std::max(maxTickTime, tickTime);
+		++ticks;
+		time += deltaTime;
+
+		//Keep ticks at wall clock pace, so queue and sync delays match the windowed master
+		if (isRealtime)
+			std::this_thread::sleep_until(tickStart + std::chrono::duration<double>(deltaTime));
+	}
+	simulation.getInputLatency().report(InputLatency::now(), true);
+
+	Log::Info("Headless run done: %llu ticks in %.3f s (%.0f ticks/s), mean tick %.1f us, max tick %.1f us",
+		static_cast<unsigned long long>(ticks), totalTickTime, ticks / totalTickTime,
+		1e6 * totalTickTime / ticks, 1e6 * maxTickTime);
+	Log::Info("%llu input messages, %llu point events, %zu collectibles enabled at the end, "
+		"%.1f sync bytes per tick",
+		static_cast<unsigned long long>(loadGenerator.getNumGenerated()),
+		static_cast<unsigned long long>(pointEvents), simulation.getNumCollectibles(),
+		static_cast<double>(stateSync.getEncodedBytes()) / ticks);
+	Log::Info("Turn input: %llu messages coalesced, %llu dropped",
+		static_cast<unsigned long long>(inputCoalesced), static_cast<unsigned long long>(inputDropped));
+	Log::Info("%llu scoreboard messages sent in %llu batches, %llu bytes",
+		static_cast<unsigned long long>(numServerMessages), static_cast<unsigned long long>(serverBatches),
+		static_cast<unsigned long long>(serverBytes));
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,108 @@
+#include "inputlatency.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+#include "sgct/log.h"
+#include "sgct/profiling.h"
+
+void LatencyHistogram::add(int64_t micros, uint64_t count)
+{
+	micros = std::max<int64_t>(micros, 0);
+	size_t bucket = 0;
+	if (micros > mFIRSTBUCKET)
+		bucket = static_cast<size_t>(std::ceil(4.0 * std::log2(micros / mFIRSTBUCKET)));
+
+	mBuckets[std::min(bucket, mNUMBUCKETS - 1)] += count;
+	mCount += count;
+	mSum += static_cast<double>(micros) * count;
+	mMax = std::max(mMax, micros);
+}
+
+void LatencyHistogram::clear()
+{
+	mBuckets.fill(0);
+	mCount = 0;
+	mSum = 0.0;
+	mMax = 0;
+}
+
+double LatencyHistogram::getPercentile(double p) const
+{
+	const double target = p * mCount;
+	uint64_t seen = 0;
+	for (size_t bucket = 0; bucket < mNUMBUCKETS; bucket++)
+	{
+		seen += mBuckets[bucket];
+		if (seen >= target && seen > 0)
+			return std::min(mFIRSTBUCKET * std::exp2(bucket / 4.0), static_cast<double>(mMax));
+	}
+	return static_cast<double>(mMax);
+}
+
+int64_t InputLatency::now()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void InputLatency::record(Stage stage, int64_t from, int64_t to)
+{
+	if (from <= 0)
+		return;
+
+	mHistograms[stage].add(to - from);
+	mNewest[stage] = to - from;
+}
+
+void InputLatency::markSimulated(int64_t applyTime, int64_t doneTime, uint64_t count)
+{
+	if (count == 0)
+		return;
+
+	mHistograms[Apply].add(doneTime - applyTime, count);
+	mNewest[Apply] = doneTime - applyTime;
+	mUnsynced.emplace_back(doneTime, count);
+}
+
+void InputLatency::markSynced(int64_t time)
+{
+	for (const std::pair<int64_t, uint64_t>& simulated : mUnsynced)
+	{
+		mHistograms[Sync].add(time - simulated.first, simulated.second);
+		mNewest[Sync] = time - simulated.first;
+	}
+	mUnsynced.clear();
+}
+
+void InputLatency::report(int64_t time, bool force)
+{
+#ifdef TRACY_ENABLE
+	TracyPlot("Input relay (ms)", mNewest[Relay] / 1000.0);
+	TracyPlot("Input queue (ms)", mNewest[Queue] / 1000.0);
+	TracyPlot("Input apply (ms)", mNewest[Apply] / 1000.0);
+	TracyPlot("Input sync (ms)", mNewest[Sync] / 1000.0);
+#endif
+
+	if (mLastSummary == 0)
+		mLastSummary = time;
+	if (!force && time - mLastSummary < mSUMMARYINTERVAL)
+		return;
+
+	static constexpr const char* names[NumStages] = { "relay", "queue", "apply", "sync" };
+	for (size_t stage = 0; stage < NumStages; stage++)
+	{
+		LatencyHistogram& histogram = mHistograms[stage];
+		if (histogram.getCount() == 0)
+			continue;
+
+		sgct::Log::Info("Input latency %s: %llu inputs, mean %.2f ms, p50 %.2f ms, p95 %.2f ms, "
+			"p99 %.2f ms, max %.2f ms", names[stage], static_cast<unsigned long long>(histogram.getCount()),
+			histogram.getMean() / 1000.0, histogram.getPercentile(0.5) / 1000.0,
+			histogram.getPercentile(0.95) / 1000.0, histogram.getPercentile(0.99) / 1000.0,
+			histogram.getMax() / 1000.0);
+		histogram.clear();
+	}
+	mLastSummary = time;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+//Delays in microseconds, bucketed logarithmically (four buckets per doubling from 10 us)
+class LatencyHistogram
+{
+public:
+	void add(int64_t micros, uint64_t count = 1);
+	void clear();
+
+	uint64_t getCount() const { return mCount; }
+	double getMean() const { return mCount > 0 ? mSum / mCount : 0.0; }
+	int64_t getMax() const { return mMax; }
+	//Upper bound of the bucket holding the fraction p of the smallest samples
+	double getPercentile(double p) const;
+
+private:
+	static constexpr size_t mNUMBUCKETS = 80;
+	static constexpr double mFIRSTBUCKET = 10.0;
+
+	std::array<uint64_t, mNUMBUCKETS> mBuckets{};
+	uint64_t mCount = 0;
+	double mSum = 0.0;
+	int64_t mMax = 0;
+};
+
+//How long phone input takes from the web server until it is part of a synced frame
+//Timestamps are microseconds on the wall clock (now()), the relay stamps its messages
+//with the same clock, so the relay stage needs the server and master clocks in sync
+//(they usually are the same machine). The stages of an input:
+//  Relay: stamped by webserver/server.js until read from the socket on the master
+//  Queue: read from the socket until applied by Simulation::update
+//  Apply: applied until the simulation step with it is done
+//  Sync: step done until the master is past the frame that sent the state to the nodes
+class InputLatency
+{
+public:
+	enum Stage { Relay, Queue, Apply, Sync, NumStages };
+
+	static int64_t now();
+
+	//Add the delay from..to to stage, ignored if from is unknown (0)
+	void record(Stage stage, int64_t from, int64_t to);
+
+	//count inputs were applied at applyTime and simulated until doneTime
+	//They are recorded in the Sync stage by the next markSynced
+	void markSimulated(int64_t applyTime, int64_t doneTime, uint64_t count);
+	//The state of all simulated inputs has been sent to the nodes
+	void markSynced(int64_t time);
+
+	//Plot the newest delays in Tracy, and every mSUMMARYINTERVAL log a summary of each
+	//stage and start over. force logs the summary right away
+	void report(int64_t time, bool force = false);
+
+	const LatencyHistogram& getHistogram(Stage stage) const { return mHistograms[stage]; }
+
+private:
+	static constexpr int64_t mSUMMARYINTERVAL = 10'000'000;
+
+	std::array<LatencyHistogram, NumStages> mHistograms;
+	std::array<int64_t, NumStages> mNewest{};
+	//(simulation done time, number of inputs) waiting for markSynced
+	std::vector<std::pair<int64_t, uint64_t>> mUnsynced;
+	int64_t mLastSummary = 0;
+};
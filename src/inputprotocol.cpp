@@ -0,0 +1,142 @@
+#include "inputprotocol.hpp"
+
+#include <charconv>
+#include <cstring>
+#include <cstdlib>
+
+#include "sgct/profiling.h"
+
+namespace
+{
+	template<typename T>
+	T readLittleEndian(const std::byte* data)
+	{
+		T value;
+		std::memcpy(&value, data, sizeof(T));
+		return value;
+	}
+
+	template<typename T>
+	void writeLittleEndian(std::byte* data, T value)
+	{
+		std::memcpy(data, &value, sizeof(T));
+	}
+
+	//Next space separated token of text starting at pos
+	std::string_view nextToken(std::string_view text, size_t& pos)
+	{
+		while (pos < text.size() && text[pos] == ' ')
+			pos++;
+		const size_t start = pos;
+		while (pos < text.size() && text[pos] != ' ')
+			pos++;
+		return text.substr(start, pos - start);
+	}
+}
+
+bool InputProtocol::isPlayerMessage(char type)
+{
+	return type == 'N' || type == 'C' || type == 'D' || type == 'E' || type == 'I' || type == 'Y';
+}
+
+bool InputProtocol::decode(const void* data, size_t length, InputMessage& message)
+{
+	const std::byte* bytes = static_cast<const std::byte*>(data);
+	if (length >= mHEADERSIZE && std::to_integer<uint8_t>(bytes[1]) == mVERSION)
+		return decodeBinary(bytes, length, message);
+
+	return decodeText(std::string_view(static_cast<const char*>(data), length), message);
+}
+
+bool InputProtocol::decodeBinary(const std::byte* data, size_t length, InputMessage& message)
+{
+	ZoneScoped;
+	if (length < mHEADERSIZE || std::to_integer<uint8_t>(data[1]) != mVERSION)
+		return false;
+
+	const uint16_t payloadLength = readLittleEndian<uint16_t>(data + 2);
+	if (mHEADERSIZE + payloadLength > length)
+		return false;
+
+	message.mType = std::to_integer<char>(data[0]);
+	message.mPlayerId = readLittleEndian<uint32_t>(data + 4);
+	message.mSequence = readLittleEndian<uint32_t>(data + 8);
+	message.mHasSequence = true;
+	message.mValue = readLittleEndian<float>(data + 12);
+	message.mRelayTime = readLittleEndian<int64_t>(data + 16);
+	message.mName = std::string_view(reinterpret_cast<const char*>(data + mHEADERSIZE), payloadLength);
+
+	return isPlayerMessage(message.mType);
+}
+
+bool InputProtocol::decodeText(std::string_view text, InputMessage& message)
+{
+	ZoneScoped;
+	if (text.size() < 3 || text[1] != ' ' || !isPlayerMessage(text[0]))
+		return false;
+
+	size_t pos = 1;
+	const std::string_view id = nextToken(text, pos);
+	if (std::from_chars(id.data(), id.data() + id.size(), message.mPlayerId).ec != std::errc())
+		return false;
+
+	message.mType = text[0];
+	message.mSequence = 0;
+	message.mHasSequence = false;
+	message.mRelayTime = 0;
+	message.mValue = 0.f;
+	message.mName = {};
+
+	const std::string_view argument = nextToken(text, pos);
+	if (message.mType == 'N' || message.mType == 'Y')
+	{
+		message.mName = argument;
+	}
+	else if (message.mType == 'C')
+	{
+		//strtof needs a terminated string, copy the number to the stack
+		char number[32];
+		if (argument.empty() || argument.size() >= sizeof(number))
+			return false;
+		std::memcpy(number, argument.data(), argument.size());
+		number[argument.size()] = '\0';
+
+		char* end;
+		message.mValue = std::strtof(number, &end);
+		if (end == number)
+			return false;
+	}
+
+	return true;
+}
+
+void InputProtocol::encodeBinary(const InputMessage& message, std::vector<std::byte>& output)
+{
+	output.resize(mHEADERSIZE + message.mName.size());
+	output[0] = std::byte(message.mType);
+	output[1] = std::byte(mVERSION);
+	writeLittleEndian(output.data() + 2, static_cast<uint16_t>(message.mName.size()));
+	writeLittleEndian(output.data() + 4, message.mPlayerId);
+	writeLittleEndian(output.data() + 8, message.mSequence);
+	writeLittleEndian(output.data() + 12, message.mValue);
+	writeLittleEndian(output.data() + 16, message.mRelayTime);
+	std::memcpy(output.data() + mHEADERSIZE, message.mName.data(), message.mName.size());
+}
+
+void InputProtocol::encodeText(const InputMessage& message, std::string& output)
+{
+	output.clear();
+	output += message.mType;
+	output += ' ';
+	output += std::to_string(message.mPlayerId);
+	if (message.mType == 'N' || message.mType == 'Y')
+	{
+		output += ' ';
+		output += message.mName;
+	}
+	else if (message.mType == 'C')
+	{
+		output += ' ';
+		output += std::to_string(message.mValue);
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+//One message from the web server about a player
+//mName points into the buffer the message was decoded from, only valid as long as it
+struct InputMessage
+{
+	char mType = 0;
+	uint32_t mPlayerId = 0;
+	uint32_t mSequence = 0;
+	float mValue = 0.f;
+	std::string_view mName;
+	//Only binary messages carry a sequence number
+	bool mHasSequence = false;
+	//When the web server sent the message, microseconds on InputLatency::now(), 0 if unknown
+	int64_t mRelayTime = 0;
+};
+
+//Messages from webserver/server.js to the game, decoded in place without allocating
+//
+//Binary format (little endian), a fixed 24 byte header followed by the payload:
+//  u8 type, u8 version, u16 payload length, u32 player id, u32 sequence, f32 value,
+//  u64 relay time
+//  The types are the letters of the text messages. C carries the turn speed in value,
+//  N carries the player name as payload, Y (echo request from a phone) a token that the
+//  game sends back to it. sequence counts all messages sent by the server
+//  relay time is when the server sent it, microseconds since the Unix epoch
+//
+//Text format (compatibility with older servers): "<type> <id> [<turn speed or name>]"
+//The first byte after the type is a space in text and the version in binary messages
+class InputProtocol
+{
+public:
+	static constexpr uint8_t mVERSION = 2;
+	static constexpr size_t mHEADERSIZE = 24;
+
+	//Decode a message in either format, returns false for anything that is not a player
+	//message (status texts from the server) or is truncated
+	static bool decode(const void* data, size_t length, InputMessage& message);
+
+	static bool decodeBinary(const std::byte* data, size_t length, InputMessage& message);
+	static bool decodeText(std::string_view text, InputMessage& message);
+
+	//Replace the content of output with message, used by the load generator
+	static void encodeBinary(const InputMessage& message, std::vector<std::byte>& output);
+	static void encodeText(const InputMessage& message, std::string& output);
+
+private:
+	static bool isPlayerMessage(char type);
+};
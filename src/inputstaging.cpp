@@ -0,0 +1,63 @@
+#include "inputstaging.hpp"
+
+#include "sgct/profiling.h"
+
+void InputStaging::init(size_t maxPlayers)
+{
+	mTurnSpeeds.assign(maxPlayers, 0.f);
+	mReceiveTimes.assign(maxPlayers, 0);
+	mSequences.assign(maxPlayers, 0);
+	mHasSequence.assign(maxPlayers, 0);
+	mIsStaged.assign(maxPlayers, 0);
+	mStaged.clear();
+	mStaged.reserve(maxPlayers);
+}
+
+void InputStaging::grow(size_t maxPlayers)
+{
+	if (maxPlayers <= mTurnSpeeds.size())
+		return;
+
+	mTurnSpeeds.resize(maxPlayers, 0.f);
+	mReceiveTimes.resize(maxPlayers, 0);
+	mSequences.resize(maxPlayers, 0);
+	mHasSequence.resize(maxPlayers, 0);
+	mIsStaged.resize(maxPlayers, 0);
+	mStaged.reserve(maxPlayers);
+}
+
+void InputStaging::stageTurnSpeed(size_t id, float turnSpeed, uint32_t sequence, bool hasSequence,
+                                  int64_t receiveTime)
+{
+	ZoneScoped;
+	++mCounters.mReceived;
+	if (id >= mTurnSpeeds.size())
+	{
+		++mCounters.mDropped;
+		return;
+	}
+
+	if (hasSequence)
+	{
+		//Sequence numbers wrap around, newer means less than half the range ahead
+		if (mHasSequence[id] && static_cast<int32_t>(sequence - mSequences[id]) <= 0)
+		{
+			++mCounters.mDropped;
+			return;
+		}
+		mSequences[id] = sequence;
+		mHasSequence[id] = 1;
+	}
+
+	if (mIsStaged[id])
+	{
+		++mCounters.mCoalesced;
+	}
+	else
+	{
+		mIsStaged[id] = 1;
+		mStaged.push_back(static_cast<uint32_t>(id));
+	}
+	mTurnSpeeds[id] = turnSpeed;
+	mReceiveTimes[id] = receiveTime;
+}
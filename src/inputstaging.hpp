@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+//Newest turn input per player, filled as messages arrive and applied once per update
+//Phones can send faster than the dome renders, so only the latest value of each player
+//is kept. Messages with a sequence number older than the newest one seen for that
+//player are dropped instead of overwriting newer input
+class InputStaging
+{
+public:
+	//Per update counts of turn messages
+	struct Counters
+	{
+		uint32_t mReceived = 0;
+		//Replaced by a newer message before they were applied
+		uint32_t mCoalesced = 0;
+		//Out of order or for an unknown player
+		uint32_t mDropped = 0;
+		uint32_t mApplied = 0;
+	};
+
+	void init(size_t maxPlayers);
+	//Make room for maxPlayers players, keeps staged input
+	void grow(size_t maxPlayers);
+
+	//Stage turnSpeed for player id, sequence is only compared if hasSequence is set
+	//(binary messages), text messages always count as the newest
+	//receiveTime is kept with the input for the latency stats, 0 if unknown
+	void stageTurnSpeed(size_t id, float turnSpeed, uint32_t sequence, bool hasSequence,
+	                    int64_t receiveTime = 0);
+
+	//Call apply(id, turnSpeed, receiveTime) for every player with staged input and clear
+	//the table
+	//Players at numPlayers or above are dropped
+	template<typename Fn>
+	void apply(size_t numPlayers, Fn&& apply);
+
+	//DEBUGGING TOOL: turn every player by deltaOrientation, added up until taken
+	void stageRotation(float deltaOrientation) { mRotation += deltaOrientation; }
+	float takeRotation() { const float rotation = mRotation; mRotation = 0.f; return rotation; }
+
+	//Counters of the last apply
+	const Counters& getCounters() const { return mLastCounters; }
+
+private:
+	std::vector<float> mTurnSpeeds;
+	std::vector<int64_t> mReceiveTimes;
+	std::vector<uint32_t> mSequences;
+	std::vector<uint8_t> mHasSequence;
+	//Players with staged input, each once
+	std::vector<uint32_t> mStaged;
+	std::vector<uint8_t> mIsStaged;
+
+	float mRotation = 0.f;
+
+	Counters mCounters;
+	Counters mLastCounters;
+};
+
+template<typename Fn>
+void InputStaging::apply(size_t numPlayers, Fn&& apply)
+{
+	for (uint32_t id : mStaged)
+	{
+		mIsStaged[id] = 0;
+		if (id < numPlayers)
+		{
+			apply(id, mTurnSpeeds[id], mReceiveTimes[id]);
+			++mCounters.mApplied;
+		}
+		else
+		{
+			++mCounters.mDropped;
+		}
+	}
+	mStaged.clear();
+
+	mLastCounters = mCounters;
+	mCounters = Counters{};
+}
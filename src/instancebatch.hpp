@@ -0,0 +1,142 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "glad/glad.h"
+#include "glm/glm.hpp"
+#include <glm/gtc/type_ptr.hpp>
+#include "sgct/shadermanager.h"
+#include "sgct/shaderprogram.h"
+#include "sgct/profiling.h"
+
+#include "mesh.hpp"
+#include "modelmanager.hpp"
+#include "constants.hpp"
+
+//Per-instance data of many objects, grouped by model slot in ModelManager and streamed
+//to one GL buffer once per frame, then drawn with one instanced draw per model
+//The shader gets mvp, view and cameraPos as uniforms, everything else per instance
+template<typename Instance>
+class InstanceBatch
+{
+public:
+	//Create the GL buffer and look up the shader, needs a GL context
+	//layout describes how Instance maps to vertex attributes
+	void init(const std::string& shaderName, const InstanceLayout& layout, size_t maxInstances);
+
+	//Rebuild from n objects. modelOf(i) returns the model slot of object i, or a negative
+	//value to leave it out. fill(i, instance) writes the per-instance data of object i
+	//Call once per frame, before render() for any viewport
+	template<typename ModelOf, typename Fill>
+	void build(size_t n, ModelOf&& modelOf, Fill&& fill);
+
+	//Draw everything from the last build()
+	void render(const glm::mat4& mvp, const glm::mat4& v) const;
+
+	size_t size() const { return mNumInstances; }
+
+private:
+	GLuint mBuffer = 0;
+	InstanceLayout mLayout;
+
+	//mModelFirst[m] to mModelFirst[m] + mModelCount[m] is the range of model m in mInstances
+	std::vector<Instance> mInstances;
+	std::vector<size_t> mModelFirst;
+	std::vector<size_t> mModelCount;
+	size_t mNumInstances = 0;
+
+	const sgct::ShaderProgram* mShader = nullptr;
+	GLint mMvpLoc = -1;
+	GLint mViewLoc = -1;
+	GLint mCameraPosLoc = -1;
+};
+
+template<typename Instance>
+void InstanceBatch<Instance>::init(const std::string& shaderName, const InstanceLayout& layout,
+                                   size_t maxInstances)
+{
+	mLayout = layout;
+	mInstances.resize(maxInstances);
+	mModelFirst.resize(allModelNames.size());
+	mModelCount.resize(allModelNames.size());
+
+	glGenBuffers(1, &mBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, mBuffer);
+	glBufferData(GL_ARRAY_BUFFER, maxInstances * sizeof(Instance), nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	mShader = &sgct::ShaderManager::instance().shaderProgram(shaderName);
+	mMvpLoc = glGetUniformLocation(mShader->id(), "mvp");
+	mViewLoc = glGetUniformLocation(mShader->id(), "view");
+	mCameraPosLoc = glGetUniformLocation(mShader->id(), "cameraPos");
+}
+
+template<typename Instance>
+template<typename ModelOf, typename Fill>
+void InstanceBatch<Instance>::build(size_t n, ModelOf&& modelOf, Fill&& fill)
+{
+	ZoneScoped;
+	//Counting sort of the objects by model slot
+	std::fill(mModelCount.begin(), mModelCount.end(), 0);
+	for (size_t i = 0; i < n; i++)
+	{
+		const int m = modelOf(i);
+		if (m >= 0)
+			mModelCount[m]++;
+	}
+
+	mNumInstances = 0;
+	for (size_t m = 0; m < mModelCount.size(); m++)
+	{
+		mModelFirst[m] = mNumInstances;
+		mNumInstances += mModelCount[m];
+	}
+	if (mNumInstances == 0)
+		return;
+
+	//Only grows if there are more objects than init() was told about
+	const bool grown = mNumInstances > mInstances.size();
+	if (grown)
+		mInstances.resize(mNumInstances);
+
+	std::fill(mModelCount.begin(), mModelCount.end(), 0);
+	for (size_t i = 0; i < n; i++)
+	{
+		const int m = modelOf(i);
+		if (m >= 0)
+			fill(i, mInstances[mModelFirst[m] + mModelCount[m]++]);
+	}
+
+	//Orphan the buffer so the driver does not wait for last frame's draws
+	glBindBuffer(GL_ARRAY_BUFFER, mBuffer);
+	glBufferData(GL_ARRAY_BUFFER, mInstances.size() * sizeof(Instance), nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, mNumInstances * sizeof(Instance), mInstances.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+template<typename Instance>
+void InstanceBatch<Instance>::render(const glm::mat4& mvp, const glm::mat4& v) const
+{
+	if (mNumInstances == 0)
+		return;
+
+	mShader->bind();
+
+	glm::vec3 cameraPos = glm::vec3((glm::inverse(v))[3]);
+	glUniform3fv(mCameraPosLoc, 1, glm::value_ptr(cameraPos));
+	glUniformMatrix4fv(mMvpLoc, 1, GL_FALSE, glm::value_ptr(mvp));
+	glUniformMatrix4fv(mViewLoc, 1, GL_FALSE, glm::value_ptr(v));
+
+	for (size_t m = 0; m < mModelCount.size(); m++)
+	{
+		if (mModelCount[m] == 0)
+			continue;
+
+		ModelManager::instance().getModel(static_cast<int>(m))
+			.renderInstanced(mBuffer, mLayout, mModelFirst[m], static_cast<GLsizei>(mModelCount[m]));
+	}
+
+	mShader->unbind();
+}
@@ -0,0 +1,379 @@
+#include "integrator.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "sgct/profiling.h"
+
+#if defined(__AVX2__)
+	#define DOMEDAGEN_SIMD_AVX2
+	#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define DOMEDAGEN_SIMD_SSE2
+	#include <emmintrin.h>
+#endif
+
+namespace {
+#if defined(DOMEDAGEN_SIMD_AVX2)
+	//Thin wrappers so the kernels below can be written once for every instruction set
+	struct Simd
+	{
+		using V = __m256;
+		using VI = __m256i;
+		static constexpr size_t WIDTH = 8;
+		static constexpr const char* NAME = "AVX2";
+
+		static V load(const float* p) { return _mm256_loadu_ps(p); }
+		static void store(float* p, V v) { _mm256_storeu_ps(p, v); }
+		static V set1(float f) { return _mm256_set1_ps(f); }
+		static V add(V a, V b) { return _mm256_add_ps(a, b); }
+		static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+		static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+		static V div(V a, V b) { return _mm256_div_ps(a, b); }
+		static V sqrt(V a) { return _mm256_sqrt_ps(a); }
+		static V bitAnd(V a, V b) { return _mm256_and_ps(a, b); }
+		static V bitAndNot(V a, V b) { return _mm256_andnot_ps(a, b); }
+		static V bitXor(V a, V b) { return _mm256_xor_ps(a, b); }
+		static V cmpGt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+		static V cmpGe(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+		static V select(V mask, V a, V b) { return _mm256_blendv_ps(b, a, mask); }
+		static int moveMask(V mask) { return _mm256_movemask_ps(mask); }
+
+		static VI toInt(V a) { return _mm256_cvttps_epi32(a); }
+		static V toFloat(VI a) { return _mm256_cvtepi32_ps(a); }
+		static V asFloat(VI a) { return _mm256_castsi256_ps(a); }
+		static VI set1i(int i) { return _mm256_set1_epi32(i); }
+		static VI addi(VI a, VI b) { return _mm256_add_epi32(a, b); }
+		static VI subi(VI a, VI b) { return _mm256_sub_epi32(a, b); }
+		static VI andi(VI a, VI b) { return _mm256_and_si256(a, b); }
+		static VI andNoti(VI a, VI b) { return _mm256_andnot_si256(a, b); }
+		static VI cmpEqi(VI a, VI b) { return _mm256_cmpeq_epi32(a, b); }
+		static VI shiftLeft29(VI a) { return _mm256_slli_epi32(a, 29); }
+
+		//All bits set in lanes where the byte flag is non-zero
+		static V flagMask(const uint8_t* flags)
+		{
+			VI wide = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(flags)));
+			return asFloat(_mm256_cmpgt_epi32(wide, _mm256_setzero_si256()));
+		}
+	};
+#elif defined(DOMEDAGEN_SIMD_SSE2)
+	struct Simd
+	{
+		using V = __m128;
+		using VI = __m128i;
+		static constexpr size_t WIDTH = 4;
+		static constexpr const char* NAME = "SSE2";
+
+		static V load(const float* p) { return _mm_loadu_ps(p); }
+		static void store(float* p, V v) { _mm_storeu_ps(p, v); }
+		static V set1(float f) { return _mm_set1_ps(f); }
+		static V add(V a, V b) { return _mm_add_ps(a, b); }
+		static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+		static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+		static V div(V a, V b) { return _mm_div_ps(a, b); }
+		static V sqrt(V a) { return _mm_sqrt_ps(a); }
+		static V bitAnd(V a, V b) { return _mm_and_ps(a, b); }
+		static V bitAndNot(V a, V b) { return _mm_andnot_ps(a, b); }
+		static V bitXor(V a, V b) { return _mm_xor_ps(a, b); }
+		static V cmpGt(V a, V b) { return _mm_cmpgt_ps(a, b); }
+		static V cmpGe(V a, V b) { return _mm_cmpge_ps(a, b); }
+		static V select(V mask, V a, V b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+		static int moveMask(V mask) { return _mm_movemask_ps(mask); }
+
+		static VI toInt(V a) { return _mm_cvttps_epi32(a); }
+		static V toFloat(VI a) { return _mm_cvtepi32_ps(a); }
+		static V asFloat(VI a) { return _mm_castsi128_ps(a); }
+		static VI set1i(int i) { return _mm_set1_epi32(i); }
+		static VI addi(VI a, VI b) { return _mm_add_epi32(a, b); }
+		static VI subi(VI a, VI b) { return _mm_sub_epi32(a, b); }
+		static VI andi(VI a, VI b) { return _mm_and_si128(a, b); }
+		static VI andNoti(VI a, VI b) { return _mm_andnot_si128(a, b); }
+		static VI cmpEqi(VI a, VI b) { return _mm_cmpeq_epi32(a, b); }
+		static VI shiftLeft29(VI a) { return _mm_slli_epi32(a, 29); }
+
+		static V flagMask(const uint8_t* flags)
+		{
+			int32_t packed;
+			std::memcpy(&packed, flags, sizeof(packed));
+			VI bytes = _mm_cvtsi32_si128(packed);
+			VI zero = _mm_setzero_si128();
+			VI wide = _mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, zero), zero);
+			return asFloat(_mm_cmpgt_epi32(wide, zero));
+		}
+	};
+#endif
+
+#if defined(DOMEDAGEN_SIMD_AVX2) || defined(DOMEDAGEN_SIMD_SSE2)
+	using V = Simd::V;
+	using VI = Simd::VI;
+
+	//Sine and cosine of every lane, Cephes single precision polynomials
+	//Accurate to a couple of ulp for |x| up to a few thousand radians
+	void sinCos(V x, V& outSin, V& outCos)
+	{
+		const V signMask = Simd::set1(-0.f);
+		V signSin = Simd::bitAnd(x, signMask);
+		x = Simd::bitAndNot(signMask, x);
+
+		//Octant of x, rounded up to even
+		VI j = Simd::toInt(Simd::mul(x, Simd::set1(1.27323954473516f)));
+		j = Simd::andi(Simd::addi(j, Simd::set1i(1)), Simd::set1i(~1));
+		V y = Simd::toFloat(j);
+
+		V swapSignSin = Simd::asFloat(Simd::shiftLeft29(Simd::andi(j, Simd::set1i(4))));
+		V polyMask = Simd::asFloat(Simd::cmpEqi(Simd::andi(j, Simd::set1i(2)), Simd::set1i(0)));
+		V signCos = Simd::asFloat(Simd::shiftLeft29(
+			Simd::andNoti(Simd::subi(j, Simd::set1i(2)), Simd::set1i(4))));
+		signSin = Simd::bitXor(signSin, swapSignSin);
+
+		//Extended precision reduction x - y * pi/4
+		x = Simd::sub(x, Simd::mul(y, Simd::set1(0.78515625f)));
+		x = Simd::sub(x, Simd::mul(y, Simd::set1(2.4187564849853515625e-4f)));
+		x = Simd::sub(x, Simd::mul(y, Simd::set1(3.77489497744594108e-8f)));
+		V z = Simd::mul(x, x);
+
+		V c = Simd::set1(2.443315711809948e-5f);
+		c = Simd::add(Simd::mul(c, z), Simd::set1(-1.388731625493765e-3f));
+		c = Simd::add(Simd::mul(c, z), Simd::set1(4.166664568298827e-2f));
+		c = Simd::mul(Simd::mul(c, z), z);
+		c = Simd::sub(c, Simd::mul(z, Simd::set1(0.5f)));
+		c = Simd::add(c, Simd::set1(1.f));
+
+		V s = Simd::set1(-1.9515295891e-4f);
+		s = Simd::add(Simd::mul(s, z), Simd::set1(8.3321608736e-3f));
+		s = Simd::add(Simd::mul(s, z), Simd::set1(-1.6666654611e-1f));
+		s = Simd::add(Simd::mul(Simd::mul(s, z), x), x);
+
+		outSin = Simd::bitXor(Simd::select(polyMask, s, c), signSin);
+		outCos = Simd::bitXor(Simd::select(polyMask, c, s), signCos);
+	}
+
+	//Returns the index where the scalar kernel has to take over
+	size_t advancePlayersBatch(EntityStore& store, size_t begin, size_t end,
+	                           float deltaTime, const BallJointConstraint& constraint)
+	{
+		const V dt = Simd::set1(deltaTime);
+		const V half = Simd::set1(0.5f);
+		const V zero = Simd::set1(0.f);
+
+		const glm::vec3& center = constraint.getCenter();
+		const glm::vec3& planePos = constraint.getPlanePos();
+		const V centerX = Simd::set1(center.x), centerY = Simd::set1(center.y), centerZ = Simd::set1(center.z);
+		const V planeX = Simd::set1(planePos.x), planeY = Simd::set1(planePos.y), planeZ = Simd::set1(planePos.z);
+
+		size_t i = begin;
+		for (; i + Simd::WIDTH <= end; i += Simd::WIDTH)
+		{
+			const V enabled = Simd::flagMask(&store.mEnabled[i]);
+			if (Simd::moveMask(enabled) == 0)
+				continue;
+
+			//Turn
+			const V oldOrient = Simd::load(&store.mOrientations[i]);
+			const V newOrient = Simd::add(oldOrient, Simd::mul(dt, Simd::load(&store.mTurnSpeeds[i])));
+			Simd::store(&store.mOrientations[i], Simd::select(enabled, newOrient, oldOrient));
+
+			//Step quaternion from the euler angles (step * cos, step * sin, 0)
+			V sinOrient, cosOrient;
+			sinCos(oldOrient, sinOrient, cosOrient);
+			const V step = Simd::mul(Simd::load(&store.mSpeeds[i]), dt);
+			V sx, cx, sy, cy;
+			sinCos(Simd::mul(Simd::mul(step, cosOrient), half), sx, cx);
+			sinCos(Simd::mul(Simd::mul(step, sinOrient), half), sy, cy);
+			const V rw = Simd::mul(cx, cy);
+			const V rx = Simd::mul(sx, cy);
+			const V ry = Simd::mul(cx, sy);
+			const V rz = Simd::sub(zero, Simd::mul(sx, sy));
+
+			//newPos = pos * r
+			const V pw = Simd::load(&store.mPosW[i]);
+			const V px = Simd::load(&store.mPosX[i]);
+			const V py = Simd::load(&store.mPosY[i]);
+			const V pz = Simd::load(&store.mPosZ[i]);
+			V nw = Simd::sub(Simd::sub(Simd::mul(pw, rw), Simd::mul(px, rx)), Simd::add(Simd::mul(py, ry), Simd::mul(pz, rz)));
+			V nx = Simd::sub(Simd::add(Simd::add(Simd::mul(pw, rx), Simd::mul(px, rw)), Simd::mul(py, rz)), Simd::mul(pz, ry));
+			V ny = Simd::sub(Simd::add(Simd::add(Simd::mul(pw, ry), Simd::mul(py, rw)), Simd::mul(pz, rx)), Simd::mul(px, rz));
+			V nz = Simd::sub(Simd::add(Simd::add(Simd::mul(pw, rz), Simd::mul(pz, rw)), Simd::mul(px, ry)), Simd::mul(py, rx));
+
+			//Ball joint range test: direction = newPos * (0, 0, -1)
+			const V two = Simd::set1(2.f);
+			const V dirX = Simd::mul(Simd::set1(-2.f), Simd::add(Simd::mul(nw, ny), Simd::mul(nx, nz)));
+			const V dirY = Simd::mul(two, Simd::sub(Simd::mul(nw, nx), Simd::mul(ny, nz)));
+			const V dirZ = Simd::sub(Simd::mul(two, Simd::add(Simd::mul(nx, nx), Simd::mul(ny, ny))), Simd::set1(1.f));
+			const V rangeDot = Simd::add(Simd::add(
+				Simd::mul(Simd::sub(dirX, planeX), centerX),
+				Simd::mul(Simd::sub(dirY, planeY), centerY)),
+				Simd::mul(Simd::sub(dirZ, planeZ), centerZ));
+			const int outOfRange = Simd::moveMask(Simd::bitAndNot(Simd::cmpGt(rangeDot, zero), enabled));
+
+			//Players outside the range are rare, clamp them with the scalar constraint
+			if (outOfRange != 0)
+			{
+				alignas(32) float w[Simd::WIDTH], x[Simd::WIDTH], y[Simd::WIDTH], z[Simd::WIDTH];
+				Simd::store(w, nw); Simd::store(x, nx); Simd::store(y, ny); Simd::store(z, nz);
+				for (size_t lane = 0; lane < Simd::WIDTH; lane++)
+				{
+					if (!(outOfRange & (1 << lane)))
+						continue;
+					glm::quat q(w[lane], x[lane], y[lane], z[lane]);
+					constraint.apply(q);
+					w[lane] = q.w; x[lane] = q.x; y[lane] = q.y; z[lane] = q.z;
+				}
+				nw = Simd::load(w); nx = Simd::load(x); ny = Simd::load(y); nz = Simd::load(z);
+			}
+
+			//Normalize
+			const V len = Simd::sqrt(Simd::add(Simd::add(Simd::mul(nw, nw), Simd::mul(nx, nx)),
+			                                   Simd::add(Simd::mul(ny, ny), Simd::mul(nz, nz))));
+			nw = Simd::div(nw, len); nx = Simd::div(nx, len); ny = Simd::div(ny, len); nz = Simd::div(nz, len);
+
+			Simd::store(&store.mPosW[i], Simd::select(enabled, nw, pw));
+			Simd::store(&store.mPosX[i], Simd::select(enabled, nx, px));
+			Simd::store(&store.mPosY[i], Simd::select(enabled, ny, py));
+			Simd::store(&store.mPosZ[i], Simd::select(enabled, nz, pz));
+		}
+		return i;
+	}
+
+	size_t spinModelsBatch(EntityStore& store, size_t begin, size_t end, const glm::quat& spin)
+	{
+		const V sw = Simd::set1(spin.w), sx = Simd::set1(spin.x), sy = Simd::set1(spin.y), sz = Simd::set1(spin.z);
+
+		size_t i = begin;
+		for (; i + Simd::WIDTH <= end; i += Simd::WIDTH)
+		{
+			const V w = Simd::load(&store.mRotW[i]);
+			const V x = Simd::load(&store.mRotX[i]);
+			const V y = Simd::load(&store.mRotY[i]);
+			const V z = Simd::load(&store.mRotZ[i]);
+
+			//rot * spin
+			Simd::store(&store.mRotW[i], Simd::sub(Simd::sub(Simd::mul(w, sw), Simd::mul(x, sx)), Simd::add(Simd::mul(y, sy), Simd::mul(z, sz))));
+			Simd::store(&store.mRotX[i], Simd::sub(Simd::add(Simd::add(Simd::mul(w, sx), Simd::mul(x, sw)), Simd::mul(y, sz)), Simd::mul(z, sy)));
+			Simd::store(&store.mRotY[i], Simd::sub(Simd::add(Simd::add(Simd::mul(w, sy), Simd::mul(y, sw)), Simd::mul(z, sx)), Simd::mul(x, sz)));
+			Simd::store(&store.mRotZ[i], Simd::sub(Simd::add(Simd::add(Simd::mul(w, sz), Simd::mul(z, sw)), Simd::mul(x, sy)), Simd::mul(y, sx)));
+		}
+		return i;
+	}
+
+	size_t collectNearBatch(const glm::vec3& direction, float cosAngle, const float* x, const float* y,
+	                        const float* z, const uint32_t* items, size_t& begin, size_t end, uint32_t* out)
+	{
+		const V dx = Simd::set1(direction.x), dy = Simd::set1(direction.y), dz = Simd::set1(direction.z);
+		const V threshold = Simd::set1(cosAngle);
+
+		size_t count = 0;
+		size_t i = begin;
+		for (; i + Simd::WIDTH <= end; i += Simd::WIDTH)
+		{
+			const V dot = Simd::add(Simd::add(Simd::mul(Simd::load(&x[i]), dx), Simd::mul(Simd::load(&y[i]), dy)),
+			                        Simd::mul(Simd::load(&z[i]), dz));
+			const int hits = Simd::moveMask(Simd::cmpGe(dot, threshold));
+			if (hits == 0)
+				continue;
+
+			//Compact the hits without a branch per lane, out has room for the whole batch
+			for (size_t lane = 0; lane < Simd::WIDTH; lane++)
+			{
+				out[count] = items[i + lane];
+				count += (hits >> lane) & 1;
+			}
+		}
+		begin = i;
+		return count;
+	}
+#endif
+
+	glm::quat spinQuat(float deltaTime)
+	{
+		//Every object spins the same amount this tick
+		return glm::quat(deltaTime * Integrator::mSPINSPEED * glm::vec3(1.f, 1.f, 1.f));
+	}
+} // namespace
+
+void Integrator::advancePlayers(EntityStore& store, size_t begin, size_t end,
+                                float deltaTime, const BallJointConstraint& constraint)
+{
+	ZoneScoped;
+	store.markDirty(begin, end);
+#if defined(DOMEDAGEN_SIMD_AVX2) || defined(DOMEDAGEN_SIMD_SSE2)
+	begin = advancePlayersBatch(store, begin, end, deltaTime, constraint);
+#endif
+	advancePlayersScalar(store, begin, end, deltaTime, constraint);
+}
+
+void Integrator::spinModels(EntityStore& store, size_t begin, size_t end, float deltaTime)
+{
+	ZoneScoped;
+	store.markDirty(begin, end);
+#if defined(DOMEDAGEN_SIMD_AVX2) || defined(DOMEDAGEN_SIMD_SSE2)
+	begin = spinModelsBatch(store, begin, end, spinQuat(deltaTime));
+#endif
+	spinModelsScalar(store, begin, end, deltaTime);
+}
+
+void Integrator::advancePlayersScalar(EntityStore& store, size_t begin, size_t end,
+                                      float deltaTime, const BallJointConstraint& constraint)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		if (!store.mEnabled[i])
+			continue;
+
+		float oldOrient = store.mOrientations[i];
+		store.mOrientations[i] = oldOrient + deltaTime * store.mTurnSpeeds[i];
+
+		glm::quat newPos = store.getPosition(i);
+		newPos *= glm::quat(store.mSpeeds[i] * deltaTime * glm::vec3(cos(oldOrient), sin(oldOrient), 0.f));
+
+		//Make sure player does not leave visible area
+		constraint.apply(newPos);
+
+		store.setPosition(i, glm::normalize(newPos));
+	}
+}
+
+void Integrator::spinModelsScalar(EntityStore& store, size_t begin, size_t end, float deltaTime)
+{
+	const glm::quat spin = spinQuat(deltaTime);
+
+	for (size_t i = begin; i < end; i++)
+		store.setModelRotation(i, store.getModelRotation(i) * spin);
+}
+
+size_t Integrator::collectNear(const glm::vec3& direction, float cosAngle,
+                               const float* x, const float* y, const float* z, const uint32_t* items,
+                               size_t begin, size_t end, uint32_t* out)
+{
+	size_t count = 0;
+#if defined(DOMEDAGEN_SIMD_AVX2) || defined(DOMEDAGEN_SIMD_SSE2)
+	count = collectNearBatch(direction, cosAngle, x, y, z, items, begin, end, out);
+#endif
+	return count + collectNearScalar(direction, cosAngle, x, y, z, items, begin, end, out + count);
+}
+
+size_t Integrator::collectNearScalar(const glm::vec3& direction, float cosAngle,
+                                     const float* x, const float* y, const float* z, const uint32_t* items,
+                                     size_t begin, size_t end, uint32_t* out)
+{
+	size_t count = 0;
+	for (size_t i = begin; i < end; i++)
+	{
+		//Same order of operations as the batch kernel
+		const float dot = (x[i] * direction.x + y[i] * direction.y) + z[i] * direction.z;
+		if (dot >= cosAngle)
+			out[count++] = items[i];
+	}
+	return count;
+}
+
+const char* Integrator::simdName()
+{
+#if defined(DOMEDAGEN_SIMD_AVX2) || defined(DOMEDAGEN_SIMD_SSE2)
+	return Simd::NAME;
+#else
+	return "scalar";
+#endif
+}
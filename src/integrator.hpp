@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+
+#include "entitystore.hpp"
+#include "balljointconstraint.hpp"
+
+//Batch update kernels running over the arrays of an EntityStore, and the collision test
+//Used by Game::update on the master instead of updating objects one by one
+//
+//The batch kernels process several objects per instruction when the compiler targets
+//SSE2 (always the case on x86-64) or AVX2 (enable DOMEDAGEN_AVX2 in CMake). Objects that
+//do not fill a whole vector and platforms without SSE2 use the scalar kernels, which are
+//also the reference the vectorized kernels are checked against
+class Integrator
+{
+public:
+	//Move enabled objects in [begin, end) forward along their orientation and turn them
+	//by their turn speed, then clamp them to the visible area
+	static void advancePlayers(EntityStore& store, size_t begin, size_t end,
+	                           float deltaTime, const BallJointConstraint& constraint);
+
+	//Spin the model rotation of objects in [begin, end)
+	static void spinModels(EntityStore& store, size_t begin, size_t end, float deltaTime);
+
+	//Write items[i] for every direction i in [begin, end) with dot(direction, (x, y, z)[i])
+	//>= cosAngle to out and return how many were written. out needs room for end - begin
+	//Directions are unit vectors in separate arrays, as in SphereGrid
+	static size_t collectNear(const glm::vec3& direction, float cosAngle,
+	                          const float* x, const float* y, const float* z, const uint32_t* items,
+	                          size_t begin, size_t end, uint32_t* out);
+
+	//Scalar reference versions of the kernels above
+	static void advancePlayersScalar(EntityStore& store, size_t begin, size_t end,
+	                                 float deltaTime, const BallJointConstraint& constraint);
+	static void spinModelsScalar(EntityStore& store, size_t begin, size_t end, float deltaTime);
+	static size_t collectNearScalar(const glm::vec3& direction, float cosAngle,
+	                                const float* x, const float* y, const float* z, const uint32_t* items,
+	                                size_t begin, size_t end, uint32_t* out);
+
+	//Name of the instruction set used by the batch kernels, for logging
+	static const char* simdName();
+
+	//Angular speed of the collectible spin around each axis (radians per second)
+	static constexpr float mSPINSPEED = 1.2f;
+};
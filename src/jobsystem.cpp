@@ -0,0 +1,121 @@
+#include "jobsystem.hpp"
+
+#include <algorithm>
+
+#include "sgct/profiling.h"
+
+JobSystem::JobSystem(unsigned numThreads)
+{
+	if (numThreads == 0)
+		numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	for (unsigned i = 0; i < numThreads; i++)
+		mQueues.push_back(std::make_unique<Queue>());
+
+	for (unsigned i = 1; i < numThreads; i++)
+		mWorkers.emplace_back([this, i]() { workerLoop(i); });
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard lock(mWakeMutex);
+		mStop = true;
+	}
+	mWake.notify_all();
+	for (std::thread& worker : mWorkers)
+		worker.join();
+}
+
+void JobSystem::run(size_t count, size_t chunkSize, Kernel kernel, void* context)
+{
+	ZoneScoped;
+	const size_t numChunks = (count + chunkSize - 1) / chunkSize;
+	mRemaining.store(numChunks, std::memory_order_relaxed);
+
+	//Neighbouring chunks go to the same thread, it only steals once its own are done
+	const size_t numQueues = mQueues.size();
+	for (size_t q = 0; q < numQueues; q++)
+	{
+		Queue& queue = *mQueues[q];
+		std::lock_guard lock(queue.mMutex);
+		for (size_t c = q * numChunks / numQueues; c < (q + 1) * numChunks / numQueues; c++)
+			queue.mJobs.push_back(Job{ kernel, context, c * chunkSize, std::min(count, (c + 1) * chunkSize) });
+	}
+
+	{
+		std::lock_guard lock(mWakeMutex);
+		++mGeneration;
+	}
+	mWake.notify_all();
+
+	Job job;
+	while (mRemaining.load(std::memory_order_acquire) > 0)
+	{
+		if (pop(0, job) || steal(0, job))
+		{
+			job.mKernel(job.mContext, job.mBegin, job.mEnd);
+			mRemaining.fetch_sub(1, std::memory_order_release);
+		}
+		else
+		{
+			//The last chunks are running on other threads
+			std::this_thread::yield();
+		}
+	}
+}
+
+bool JobSystem::pop(size_t index, Job& job)
+{
+	Queue& queue = *mQueues[index];
+	std::lock_guard lock(queue.mMutex);
+	if (queue.mJobs.empty())
+		return false;
+
+	job = queue.mJobs.back();
+	queue.mJobs.pop_back();
+	return true;
+}
+
+bool JobSystem::steal(size_t thief, Job& job)
+{
+	for (size_t offset = 1; offset < mQueues.size(); offset++)
+	{
+		Queue& queue = *mQueues[(thief + offset) % mQueues.size()];
+		std::lock_guard lock(queue.mMutex);
+		if (queue.mJobs.empty())
+			continue;
+
+		job = queue.mJobs.front();
+		queue.mJobs.pop_front();
+		mSteals.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+	return false;
+}
+
+void JobSystem::workerLoop(size_t index)
+{
+#ifdef TRACY_ENABLE
+	tracy::SetThreadName("Job worker");
+#endif
+	uint64_t generation = 0;
+	while (true)
+	{
+		{
+			std::unique_lock lock(mWakeMutex);
+			mWake.wait(lock, [&]() { return mStop || mGeneration != generation; });
+			if (mStop)
+				return;
+			generation = mGeneration;
+		}
+
+		Job job;
+		while (pop(index, job) || steal(index, job))
+		{
+			ZoneScopedN("Job");
+			job.mKernel(job.mContext, job.mBegin, job.mEnd);
+			mRemaining.fetch_sub(1, std::memory_order_release);
+		}
+	}
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
+
+//Work-stealing scheduler for splitting a loop of the simulation step over several cores
+//Every thread has its own deque of chunks. It takes work from the back of its own and,
+//once that is empty, steals from the front of the others, so threads that got the cheap
+//chunks help with the expensive ones
+//The thread calling parallelFor works on the chunks too and returns once all are done
+//Only one thread may call parallelFor at a time
+class JobSystem
+{
+public:
+	//numThreads includes the calling thread, 0 uses every core. 1 runs everything inline
+	explicit JobSystem(unsigned numThreads);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	unsigned getNumThreads() const { return static_cast<unsigned>(mQueues.size()); }
+
+	//Call fn(begin, end) for chunks of at most chunkSize covering [0, count)
+	//Chunks run in any order and on any thread, fn must only write state of its own range
+	template<typename Fn>
+	void parallelFor(size_t count, size_t chunkSize, Fn&& fn);
+
+	//Chunks run by another thread than the one they were queued for, for instrumentation
+	uint64_t getSteals() const { return mSteals.load(std::memory_order_relaxed); }
+
+private:
+	using Kernel = void(*)(void* context, size_t begin, size_t end);
+
+	struct Job
+	{
+		Kernel mKernel;
+		void* mContext;
+		size_t mBegin;
+		size_t mEnd;
+	};
+
+	//On its own cache line, owners and thieves of different queues don't share one
+	struct alignas(64) Queue
+	{
+		std::mutex mMutex;
+		std::deque<Job> mJobs;
+	};
+
+	template<typename Fn>
+	static void invoke(void* context, size_t begin, size_t end)
+	{
+		(*static_cast<Fn*>(context))(begin, end);
+	}
+
+	void run(size_t count, size_t chunkSize, Kernel kernel, void* context);
+	//Take a job from the back of queue index or the front of another one
+	bool pop(size_t index, Job& job);
+	bool steal(size_t thief, Job& job);
+	void workerLoop(size_t index);
+
+	//Queue 0 belongs to the thread calling parallelFor, the others to mWorkers
+	std::vector<std::unique_ptr<Queue>> mQueues;
+	std::vector<std::thread> mWorkers;
+
+	//Chunks of the current parallelFor that are not done yet
+	std::atomic<size_t> mRemaining{ 0 };
+	std::atomic<uint64_t> mSteals{ 0 };
+
+	//Workers sleep here between parallelFor calls
+	std::mutex mWakeMutex;
+	std::condition_variable mWake;
+	uint64_t mGeneration = 0;
+	bool mStop = false;
+};
+
+template<typename Fn>
+void JobSystem::parallelFor(size_t count, size_t chunkSize, Fn&& fn)
+{
+	if (count == 0)
+		return;
+
+	if (mWorkers.empty() || count <= chunkSize)
+	{
+		fn(size_t(0), count);
+		return;
+	}
+
+	using Function = std::remove_reference_t<Fn>;
+	run(count, chunkSize, &invoke<Function>, const_cast<void*>(static_cast<const void*>(&fn)));
+}
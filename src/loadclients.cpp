@@ -0,0 +1,452 @@
+//
+//  Synthetic phones: opens many WebSocket connections to webserver/server.js or the
+//  master's PhoneServer and behaves like the phone page. Each client joins with an N
+//  message, streams C messages and now and then drops its connection and joins again.
+//  Y messages are echoed by the game, their round trips and the ones that never come
+//  back are reported. Settings in [LoadClients] in config.ini
+//
+#include <vector>
+#include <string>
+#include <deque>
+#include <chrono>
+#include <thread>
+#include <random>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+
+#include "libwebsockets.h"
+#include "sgct/log.h"
+#include "sgct/profiling.h"
+
+#include "utility.hpp"
+#include "inireader.h"
+#include "inputlatency.hpp"
+
+using namespace sgct;
+
+namespace {
+	struct Settings
+	{
+		std::string mAddress;
+		int mPort = 0;
+		unsigned mClients = 0;
+		double mDuration = 0.0;
+		//C messages per second per client, at fixed intervals or as a Poisson process
+		double mMessageRate = 0.0;
+		bool mIsPoisson = false;
+		//Joystick angles in [-1, 1] instead of the -1, 0, 1 of the buttons
+		bool mIsJoystick = false;
+		double mPingRate = 0.0;
+		//Pings not answered within this many seconds are lost
+		double mPingTimeout = 0.0;
+		//Mean disconnects per second per client, 0 for none
+		double mDisconnectRate = 0.0;
+		double mReconnectDelay = 0.0;
+		unsigned mSeed = 0;
+	};
+
+	struct Client
+	{
+		size_t mIndex = 0;
+		lws* mWsi = nullptr;
+		bool mIsConnecting = false;
+		bool mHasJoined = false;
+		bool mWantsClose = false;
+		//Times in seconds since the start of the run
+		double mConnectTime = 0.0;
+		double mNextMessageTime = 0.0;
+		double mNextPingTime = 0.0;
+		double mDisconnectTime = 0.0;
+		double mJoinTime = 0.0;
+		float mDirection = 0.f;
+		std::deque<std::string> mOutbox;
+		//Send times (microseconds) of pings waiting for their echo
+		std::deque<int64_t> mPendingPings;
+	};
+
+	struct Stats
+	{
+		uint64_t mConnects = 0;
+		uint64_t mConnectFailures = 0;
+		uint64_t mDisconnects = 0;
+		uint64_t mJoins = 0;
+		uint64_t mMessagesSent = 0;
+		uint64_t mMessagesReceived = 0;
+		uint64_t mPingsSent = 0;
+		uint64_t mPingsReturned = 0;
+		uint64_t mPingsLost = 0;
+		//Pending when their client disconnected on purpose, not counted as lost
+		uint64_t mPingsCut = 0;
+		LatencyHistogram mRoundTrip;
+		LatencyHistogram mJoinTime;
+	};
+
+	class LoadClients
+	{
+	public:
+		explicit LoadClients(const Settings& settings)
+			: mSettings(settings), mClients(settings.mClients), mGen(settings.mSeed)
+		{
+			for (size_t i = 0; i < mClients.size(); i++)
+				mClients[i].mIndex = i;
+		}
+
+		~LoadClients()
+		{
+			if (mContext)
+				lws_context_destroy(mContext);
+		}
+
+		bool run()
+		{
+			lws_protocols protocols[] = {
+				{ "phone", callback, 0, 1024, 0, this, 0 },
+				{ nullptr, nullptr, 0, 0, 0, nullptr, 0 }
+			};
+
+			lws_context_creation_info info;
+			std::memset(&info, 0, sizeof(info));
+			info.port = CONTEXT_PORT_NO_LISTEN;
+			info.protocols = protocols;
+			info.gid = -1;
+			info.uid = -1;
+			info.user = this;
+			mContext = lws_create_context(&info);
+			if (!mContext)
+				return false;
+
+			//Connections are spread over the first second, like a crowd arriving
+			std::uniform_real_distribution<double> arrival(0.0, 1.0);
+			for (Client& client : mClients)
+				client.mConnectTime = arrival(mGen);
+
+			const auto start = std::chrono::steady_clock::now();
+			double lastReport = 0.0;
+			while (mTime < mSettings.mDuration)
+			{
+				mTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				for (size_t i = 0; i < mClients.size(); i++)
+					schedule(i);
+
+				lws_service(mContext, 0);
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+				if (mTime - lastReport >= 10.0)
+				{
+					Log::Info("%.0f s: %zu clients connected, %llu C messages sent", mTime,
+						mNumConnected, static_cast<unsigned long long>(mStats.mMessagesSent));
+					lastReport = mTime;
+				}
+			}
+
+			//Pings still in flight at the end only count if they are overdue
+			for (Client& client : mClients)
+			{
+				for (int64_t sent : client.mPendingPings)
+				{
+					if (now() - sent > timeout())
+						mStats.mPingsLost++;
+				}
+			}
+
+			//Closes all connections, their callbacks are no longer counted
+			mIsStopping = true;
+			lws_context_destroy(mContext);
+			mContext = nullptr;
+			return true;
+		}
+
+		const Stats& getStats() const { return mStats; }
+
+	private:
+		static int callback(lws* wsi, lws_callback_reasons reason, void* user, void* in, size_t len)
+		{
+			//The client was passed as the user data of the connection
+			LoadClients* self = static_cast<LoadClients*>(lws_context_user(lws_get_context(wsi)));
+			if (!self || !user || self->mIsStopping)
+				return 0;
+			Client& client = *static_cast<Client*>(user);
+
+			switch (reason)
+			{
+			case LWS_CALLBACK_CLIENT_ESTABLISHED:
+				client.mIsConnecting = false;
+				self->mStats.mConnects++;
+				self->mNumConnected++;
+				//Join right away, the name is all the phone page sends first
+				client.mOutbox.push_back("N bot" + std::to_string(client.mIndex));
+				client.mJoinTime = self->mTime;
+				lws_callback_on_writable(wsi);
+				break;
+			case LWS_CALLBACK_CLIENT_RECEIVE:
+				self->receive(client, static_cast<const char*>(in), len);
+				break;
+			case LWS_CALLBACK_CLIENT_WRITEABLE:
+			{
+				if (client.mWantsClose)
+					return -1;
+				if (client.mOutbox.empty())
+					break;
+
+				const std::string& text = client.mOutbox.front();
+				self->mWriteBuffer.resize(LWS_PRE + text.size());
+				std::memcpy(self->mWriteBuffer.data() + LWS_PRE, text.data(), text.size());
+				if (lws_write(wsi, self->mWriteBuffer.data() + LWS_PRE, text.size(), LWS_WRITE_TEXT) < 0)
+					return -1;
+				client.mOutbox.pop_front();
+				if (!client.mOutbox.empty())
+					lws_callback_on_writable(wsi);
+				break;
+			}
+			case LWS_CALLBACK_CLIENT_CONNECTION_ERROR:
+				self->mStats.mConnectFailures++;
+				self->closed(client, false);
+				break;
+			case LWS_CALLBACK_CLIENT_CLOSED:
+				self->mNumConnected--;
+				self->closed(client, client.mWantsClose);
+				break;
+			default:
+				break;
+			}
+			return 0;
+		}
+
+		//Connect, send and drop clients that are due
+		void schedule(size_t index)
+		{
+			Client& client = mClients[index];
+			if (!client.mWsi)
+			{
+				if (mTime >= client.mConnectTime)
+					connect(index);
+				return;
+			}
+			if (!client.mHasJoined || client.mWantsClose)
+				return;
+
+			bool hasMessages = false;
+			while (mSettings.mMessageRate > 0.0 && mTime >= client.mNextMessageTime)
+			{
+				turn(client);
+				client.mNextMessageTime += nextInterval(mSettings.mMessageRate, mSettings.mIsPoisson);
+				hasMessages = true;
+			}
+			while (mSettings.mPingRate > 0.0 && mTime >= client.mNextPingTime)
+			{
+				//The send time is the token, so the echo carries everything needed
+				const int64_t sent = now();
+				client.mOutbox.push_back("Y " + std::to_string(sent));
+				client.mPendingPings.push_back(sent);
+				client.mNextPingTime += 1.0 / mSettings.mPingRate;
+				mStats.mPingsSent++;
+				hasMessages = true;
+			}
+			while (!client.mPendingPings.empty() && now() - client.mPendingPings.front() > timeout())
+			{
+				client.mPendingPings.pop_front();
+				mStats.mPingsLost++;
+			}
+
+			if (mSettings.mDisconnectRate > 0.0 && mTime >= client.mDisconnectTime)
+			{
+				client.mWantsClose = true;
+				hasMessages = true;
+			}
+			if (hasMessages)
+				lws_callback_on_writable(client.mWsi);
+		}
+
+		void connect(size_t index)
+		{
+			lws_client_connect_info ccinfo;
+			std::memset(&ccinfo, 0, sizeof(ccinfo));
+			ccinfo.context = mContext;
+			ccinfo.address = mSettings.mAddress.c_str();
+			ccinfo.port = mSettings.mPort;
+			ccinfo.path = "/";
+			ccinfo.host = mSettings.mAddress.c_str();
+			ccinfo.origin = "origin";
+
+			Client& client = mClients[index];
+			client = Client{};
+			client.mIndex = index;
+			client.mIsConnecting = true;
+			//The connection can fail inside the call, pwsi lets the callbacks see it first
+			ccinfo.userdata = &client;
+			ccinfo.pwsi = &client.mWsi;
+			if (!lws_client_connect_via_info(&ccinfo) && client.mIsConnecting)
+			{
+				mStats.mConnectFailures++;
+				closed(client, false);
+			}
+		}
+
+		void closed(Client& client, bool wasIntended)
+		{
+			if (client.mHasJoined)
+				mStats.mDisconnects++;
+			if (wasIntended)
+				mStats.mPingsCut += client.mPendingPings.size();
+			else
+				mStats.mPingsLost += client.mPendingPings.size();
+
+			client.mWsi = nullptr;
+			client.mIsConnecting = false;
+			client.mHasJoined = false;
+			client.mPendingPings.clear();
+			client.mConnectTime = mTime + mSettings.mReconnectDelay;
+		}
+
+		void receive(Client& client, const char* data, size_t len)
+		{
+			mStats.mMessagesReceived++;
+			if (len == 0)
+				return;
+
+			//Our colours, the game has added the player
+			if (data[0] == 'A' && !client.mHasJoined)
+			{
+				client.mHasJoined = true;
+				mStats.mJoins++;
+				mStats.mJoinTime.add(static_cast<int64_t>((mTime - client.mJoinTime) * 1e6));
+
+				std::uniform_real_distribution<double> phase(0.0, 1.0);
+				client.mNextMessageTime = mTime + phase(mGen) / std::max(mSettings.mMessageRate, 1e-6);
+				client.mNextPingTime = mTime + phase(mGen) / std::max(mSettings.mPingRate, 1e-6);
+				client.mDisconnectTime = mTime + nextInterval(mSettings.mDisconnectRate, true);
+			}
+			else if (data[0] == 'Y' && len > 2)
+			{
+				const int64_t sent = std::strtoll(std::string(data + 2, len - 2).c_str(), nullptr, 10);
+				auto pending = std::find(client.mPendingPings.begin(), client.mPendingPings.end(), sent);
+				//Echoes of pings that already timed out were counted as lost
+				if (pending == client.mPendingPings.end())
+					return;
+
+				client.mPendingPings.erase(pending);
+				mStats.mPingsReturned++;
+				mStats.mRoundTrip.add(now() - sent);
+			}
+		}
+
+		void turn(Client& client)
+		{
+			if (mSettings.mIsJoystick)
+			{
+				//Wanders like a thumb on the joystick
+				std::normal_distribution<float> step(0.f, 0.2f);
+				client.mDirection = std::clamp(client.mDirection + step(mGen), -1.f, 1.f);
+			}
+			else
+			{
+				std::uniform_int_distribution<int> button(-1, 1);
+				client.mDirection = static_cast<float>(button(mGen));
+			}
+			client.mOutbox.push_back("C " + std::to_string(client.mDirection));
+			mStats.mMessagesSent++;
+		}
+
+		static int64_t now()
+		{
+			return std::chrono::duration_cast<std::chrono::microseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		int64_t timeout() const { return static_cast<int64_t>(mSettings.mPingTimeout * 1e6); }
+
+		double nextInterval(double rate, bool isPoisson)
+		{
+			if (rate <= 0.0)
+				return 1e9;
+			if (!isPoisson)
+				return 1.0 / rate;
+			std::exponential_distribution<double> interval(rate);
+			return interval(mGen);
+		}
+
+		Settings mSettings;
+		std::vector<Client> mClients;
+		size_t mNumConnected = 0;
+		bool mIsStopping = false;
+		Stats mStats;
+		std::mt19937 mGen;
+		lws_context* mContext = nullptr;
+		double mTime = 0.0;
+		std::vector<unsigned char> mWriteBuffer;
+	};
+
+	void logHistogram(const char* name, const LatencyHistogram& histogram)
+	{
+		if (histogram.getCount() == 0)
+		{
+			Log::Info("%s: no samples", name);
+			return;
+		}
+		Log::Info("%s: %llu samples, mean %.2f ms, p50 %.2f ms, p95 %.2f ms, p99 %.2f ms, max %.2f ms",
+			name, static_cast<unsigned long long>(histogram.getCount()), histogram.getMean() / 1000.0,
+			histogram.getPercentile(0.5) / 1000.0, histogram.getPercentile(0.95) / 1000.0,
+			histogram.getPercentile(0.99) / 1000.0, histogram.getMax() / 1000.0);
+	}
+} // namespace
+
+int main(int, char**)
+{
+	Ini appConfig;
+	try
+	{
+		appConfig = readIni(Utility::findRootDir() + "/config.ini");
+	}
+	catch (const std::runtime_error & e)
+	{
+		Log::Error("%s", e.what());
+		return EXIT_FAILURE;
+	}
+	IniGroup clientConfig = appConfig["LoadClients"];
+	Settings settings;
+	settings.mAddress = clientConfig["address"];
+	settings.mPort = std::stoi(clientConfig["port"]);
+	settings.mClients = std::stoi(clientConfig["clients"]);
+	settings.mDuration = std::stod(clientConfig["duration"]);
+	settings.mMessageRate = std::stod(clientConfig["messageRate"]);
+	settings.mIsPoisson = clientConfig["arrival"] == "poisson";
+	settings.mIsJoystick = clientConfig["input"] == "joystick";
+	settings.mPingRate = std::stod(clientConfig["pingRate"]);
+	settings.mPingTimeout = std::stod(clientConfig["pingTimeout"]);
+	settings.mDisconnectRate = std::stod(clientConfig["disconnectRate"]);
+	settings.mReconnectDelay = std::stod(clientConfig["reconnectDelay"]);
+	settings.mSeed = std::stoi(clientConfig["seed"]);
+	if (settings.mSeed == 0)
+		settings.mSeed = std::random_device{}();
+
+	Log::Info("Load clients: %u clients to %s:%d for %.0f s, %.1f %s C messages/s, %.1f pings/s, "
+		"%.3f disconnects/s per client, seed %u", settings.mClients, settings.mAddress.c_str(),
+		settings.mPort, settings.mDuration, settings.mMessageRate,
+		settings.mIsPoisson ? "poisson" : "fixed", settings.mPingRate, settings.mDisconnectRate,
+		settings.mSeed);
+
+	lws_set_log_level(0, nullptr);
+	LoadClients clients(settings);
+	if (!clients.run())
+	{
+		Log::Error("Could not create the libwebsockets context");
+		return EXIT_FAILURE;
+	}
+
+	const Stats& stats = clients.getStats();
+	Log::Info("Connections: %llu, failed %llu, joins %llu, disconnects %llu",
+		static_cast<unsigned long long>(stats.mConnects), static_cast<unsigned long long>(stats.mConnectFailures),
+		static_cast<unsigned long long>(stats.mJoins), static_cast<unsigned long long>(stats.mDisconnects));
+	Log::Info("Messages: %llu C sent, %llu received",
+		static_cast<unsigned long long>(stats.mMessagesSent), static_cast<unsigned long long>(stats.mMessagesReceived));
+	const uint64_t answerable = stats.mPingsReturned + stats.mPingsLost;
+	Log::Info("Pings: %llu sent, %llu returned, %llu lost (%.2f %%), %llu cut by disconnects",
+		static_cast<unsigned long long>(stats.mPingsSent), static_cast<unsigned long long>(stats.mPingsReturned),
+		static_cast<unsigned long long>(stats.mPingsLost),
+		answerable > 0 ? 100.0 * stats.mPingsLost / answerable : 0.0,
+		static_cast<unsigned long long>(stats.mPingsCut));
+	logHistogram("Round trip", stats.mRoundTrip);
+	logHistogram("Join until colours", stats.mJoinTime);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,42 @@
+#include "loadgenerator.hpp"
+
+#include "sgct/profiling.h"
+
+LoadGenerator::LoadGenerator(unsigned numPlayers, float messageRate, unsigned seed)
+	: mPlayers(numPlayers), mInterval{ 1.0 / messageRate }, mGen{ seed }
+{
+	//Spread the players over one interval, phones do not send in lockstep
+	//Ids are handed out in joining order by the server, names are kept short
+	for (size_t id = 0; id < mPlayers.size(); id++)
+	{
+		mPlayers[id].mNextMessageTime = mChance(mGen) * mInterval;
+		mPlayers[id].mName = "bot" + std::to_string(id);
+	}
+}
+
+void LoadGenerator::generate(double time, std::vector<InputMessage>& messages)
+{
+	ZoneScoped;
+	if (!mHasJoined)
+	{
+		for (size_t id = 0; id < mPlayers.size(); id++)
+			messages.push_back({ 'N', static_cast<uint32_t>(id), mSequence++, 0.f, mPlayers[id].mName });
+		mNumGenerated += mPlayers.size();
+		mHasJoined = true;
+	}
+
+	for (size_t id = 0; id < mPlayers.size(); id++)
+	{
+		VirtualPlayer& player = mPlayers[id];
+		while (player.mNextMessageTime <= time)
+		{
+			if (mChance(mGen) < mTURNCHANCE)
+				player.mDirection = mDirection(mGen);
+
+			messages.push_back({ 'C', static_cast<uint32_t>(id), mSequence++,
+				static_cast<float>(player.mDirection), {} });
+			player.mNextMessageTime += mInterval;
+			++mNumGenerated;
+		}
+	}
+}
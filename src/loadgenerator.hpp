@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <random>
+#include <cstdint>
+
+#include "inputprotocol.hpp"
+
+//Synthetic phone input for running the master without a server or phones
+//Produces the messages webserver/server.js forwards to the game: an N message when
+//a virtual player joins, then C messages with the turn direction -1, 0 or 1 from the
+//arrow buttons on the phone page, each player at messageRate messages per second
+//All randomness comes from seed, so runs with the same settings get the same input
+class LoadGenerator
+{
+public:
+	LoadGenerator(unsigned numPlayers, float messageRate, unsigned seed);
+
+	//Append the messages due at or before time (seconds) to messages, encode them with
+	//InputProtocol to get what the server sends. Names point into the generator
+	//All players join on the first call
+	void generate(double time, std::vector<InputMessage>& messages);
+
+	uint64_t getNumGenerated() const { return mNumGenerated; }
+
+private:
+	//Chance that a player presses another button between two messages
+	static constexpr float mTURNCHANCE = 0.2f;
+
+	struct VirtualPlayer
+	{
+		double mNextMessageTime;
+		int mDirection = 0;
+		std::string mName;
+	};
+
+	std::vector<VirtualPlayer> mPlayers;
+	double mInterval;
+	bool mHasJoined = false;
+	uint64_t mNumGenerated = 0;
+	uint32_t mSequence = 0;
+
+	std::mt19937 mGen;
+	std::uniform_real_distribution<float> mChance{ 0.f, 1.f };
+	std::uniform_int_distribution<int> mDirection{ -1, 1 };
+};
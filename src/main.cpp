@@ -9,31 +9,54 @@
 #include <fstream>
 #include <sstream>
 #include <random>
-#include <glm/gtx/string_cast.hpp>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
 #include "sgct/sgct.h"
 
 #include "sgct/profiling.h"
 
 #include "websockethandler.h"
+#include "phoneserver.hpp"
 #include "utility.hpp"
 #include "game.hpp"
+#include "statesync.hpp"
+#include "inputprotocol.hpp"
+#include "servermessages.hpp"
 #include "modelmanager.hpp"
 #include "inireader.h"
 
 namespace {
 	std::unique_ptr<WebSocketHandler> wsHandler;
+	//Takes the phones directly instead of wsHandler when [Network] embeddedServer is set
+	std::unique_ptr<PhoneServer> phoneServer;
 
 	IniGroup spawnDetails;
 	IniGroup gameConfig;
 
 	bool bypassModelMatrix;
+	bool useInstancing;
+	bool interpolateSteps;
 
 	//Variables to catch sync data
 	bool isGameEnded = false, isGameStarted = false;
 	bool areStatsVisible = false;
 
-	//Container for deserialized game state info
-	std::vector<SyncableData> gameObjectStates;
+	//Delta compressed game state, encoded on master and decoded on nodes
+	StateSync stateSync;
+
+	//Game state message staged by decode() until postSyncPreDraw() on nodes
+	//Reserved for the largest possible message once, cleared but never shrunk
+	std::vector<std::byte> stateMessage;
+
+	//Size of the last encoded frame, used to size the next output buffer in one go
+	size_t lastEncodedSize = 0;
+
+	//The state encoded this frame has changes, inputs simulated so far reach the nodes
+	bool isStateSentThisFrame = false;
+
+	//Scratch space for echo messages
+	std::vector<std::byte> echoMessage;
 } // namespace
 
 using namespace sgct;
@@ -56,6 +79,9 @@ void keyboard(Key key, Modifier modifier, Action action, int);
 void connectionEstablished();
 void connectionClosed();
 void messageReceived(const void* data, size_t length);
+void inputReceived(const InputMessage& message, int64_t receiveTime);
+void queueServerMessage(const std::byte* data, size_t size);
+void queueServerMessage(const std::string& message);
 
 /****************************
 		CONSTANTS
@@ -92,10 +118,17 @@ int main(int argc, char** argv)
 	IniGroup networkConfig = appConfig["Network"];
 	IniGroup constraintConfig = appConfig["Constraint"];
 		bypassModelMatrix = constraintConfig["bypassModelMatrix"] == "true";
-		Player::setConstraints(std::stof(constraintConfig["fov"]),
-		                       std::stof(constraintConfig["tilt"]));
+		Simulation::setConstraints(std::stof(constraintConfig["fov"]),
+		                           std::stof(constraintConfig["tilt"]));
 	spawnDetails = appConfig["Spawn"];
 	gameConfig = appConfig["Game"];
+	IniGroup renderConfig = appConfig["Render"];
+		useInstancing = renderConfig["instancing"] == "true";
+		interpolateSteps = renderConfig["interpolateSteps"] == "true";
+	IniGroup syncConfig = appConfig["Sync"];
+		stateSync.setRate(std::stof(syncConfig["rate"]));
+		stateSync.setInterpolation(syncConfig["interpolate"] == "true",
+		                           std::stod(syncConfig["maxExtrapolation"]));
 
 	//Provide functions to engine handles
 	Engine::Callbacks callbacks;
@@ -111,7 +144,8 @@ int main(int argc, char** argv)
 
 	//Initialize engine
 	try {
-		gameObjectStates.reserve(Game::mMAXPLAYERS*3);
+		stateMessage.reserve(StateSync::maxMessageSize(std::stoi(gameConfig["maxPlayers"]),
+			std::stoi(gameConfig["maxCollectibles"])));
 		Engine::create(cluster, callbacks, config);
 	}
 	catch (const std::runtime_error & e) {
@@ -120,7 +154,15 @@ int main(int argc, char** argv)
 		return EXIT_FAILURE;
 	}
 
-	if (Engine::instance().isMaster()) {
+	if (Engine::instance().isMaster() && networkConfig["embeddedServer"] == "true") {
+		phoneServer = std::make_unique<PhoneServer>(
+			std::stoi(networkConfig["serverPort"]),
+			rootDir + "/" + networkConfig["publicDir"],
+			inputReceived
+		);
+		phoneServer->start();
+	}
+	else if (Engine::instance().isMaster()) {
 		wsHandler = std::make_unique<WebSocketHandler>(
 			networkConfig["ip"],
 			std::stoi(networkConfig["port"]),
@@ -129,7 +171,7 @@ int main(int argc, char** argv)
 			messageReceived
 		);
 		constexpr const int MessageSize = 1024;
-		wsHandler->connect("example-protocol", MessageSize);
+		wsHandler->connect("example-protocol", MessageSize, networkConfig["threaded"] == "true");
 	}
 	/**********************************/
 	/*			 Test Area			  */
@@ -137,6 +179,7 @@ int main(int argc, char** argv)
 
 	Engine::instance().render();
 
+	phoneServer = nullptr;
 	Game::destroy();
 	Engine::destroy();
 	return EXIT_SUCCESS;
@@ -145,8 +188,13 @@ int main(int argc, char** argv)
 void initOGL(GLFWwindow*)
 {
 	ModelManager::init();
-	Game::init();
+	Game::init(std::stoi(gameConfig["maxPlayers"]), std::stoi(gameConfig["maxCollectibles"]));
 	Game::instance().setMaxTime(std::stof(gameConfig["maxTime"]));
+	Game::instance().setTickRate(std::stod(gameConfig["tickRate"]), std::stoi(gameConfig["maxSteps"]));
+	if (Engine::instance().isMaster())
+		Game::instance().setThreads(std::stoi(gameConfig["threads"]));
+	Game::instance().setSpawnRate(std::stof(gameConfig["spawnRate"]));
+	Game::instance().setInstancing(useInstancing);
 
 	/**********************************/
 	/*			 Debug Area			  */
@@ -267,7 +315,8 @@ void keyboard(Key key, Modifier modifier, Action action, int)
 	if (key == Key::Space && modifier == Modifier::Shift && action == Action::Release)
 	{
 		Log::Info("Released space key, disconnecting");
-		wsHandler->disconnect();
+		if (wsHandler)
+			wsHandler->disconnect();
 	}
 
 	//Left
@@ -283,7 +332,7 @@ void keyboard(Key key, Modifier modifier, Action action, int)
 
 	if (key == Key::I && (action == Action::Press || action == Action::Repeat))
 	{
-		wsHandler->queueMessage("U start");
+		queueServerMessage("U start");
 
 		isGameStarted = true;
 		Game::instance().startGame();
@@ -299,34 +348,64 @@ void preSync()
 	//Run game simulation on master only
 	if (Engine::instance().isMaster())
 	{
+		//Back to the simulated state drawn blended last frame, before any input touches it
+		//and it is stepped and encoded
+		if (Game::exists())
+			Game::instance().getSimulation().endRenderBlend();
+
+		//Input from the phones is applied here, before the simulation step. Messages
+		//queued during the frame are sent on the next tick
+		if (wsHandler)
+			wsHandler->tick();
+		else if (phoneServer)
+			phoneServer->tick();
+
 		if (!isGameEnded && isGameStarted) {
-			if (Game::instance().shouldSendTime()) {
-				std::string timePassed = std::to_string(Game::instance().getPassedTime());
-				wsHandler->queueMessage("T " + timePassed);
-			}
 			Game::instance().update();
 			if (Game::instance().hasGameEnded()) {
 				if (!isGameEnded) {
-					wsHandler->queueMessage("U end");
+					queueServerMessage("U end");
 					isGameEnded = true;
 				}
 			}
 		}
-		wsHandler->tick();
 	}
 }
 
 std::vector<std::byte> encode()
 {
+	//sgct takes ownership of the returned vector, so this is the one allocation per frame
+	//Everything is written straight into it, sized so it never has to grow
 	std::vector<std::byte> output;
+	const size_t flagsSize = 3 * sizeof(bool);
+	if (Game::exists())
+		output.reserve(std::max(lastEncodedSize,
+			flagsSize + sizeof(uint32_t) + StateSync::maxMessageSize(Game::instance().getSimulation())));
 
 	serializeObject(output, isGameEnded);
 	serializeObject(output, areStatsVisible);
 	serializeObject(output, isGameStarted);
 
-	//For some reason everything has to to be put in one vector to avoid sgct syncing bugs
-	serializeObject(output, Game::instance().getSyncableData());
-
+	//Only changed fields are sent, see StateSync
+	//The message is prefixed by its size, filled in once it is written
+	const size_t sizePos = output.size();
+	serializeObject(output, uint32_t(0));
+	if (Game::exists())
+		//Stamped with the time of the last step, the nodes blend between these times
+		stateSync.encode(Game::instance().getSimulation(), output,
+			Engine::getTime() - Game::instance().getSimulation().getUnsteppedTime());
+	const uint32_t messageSize = static_cast<uint32_t>(output.size() - sizePos - sizeof(uint32_t));
+	std::memcpy(output.data() + sizePos, &messageSize, sizeof(messageSize));
+
+	//Byte count benchmark against the old full state vectors, logged here so that
+	//StateSync itself never allocates
+	if (messageSize > 0 && stateSync.getEncodedFrames() % StateSync::mKEYFRAMEINTERVAL == 0)
+		Log::Info("State sync: %.1f bytes/frame, full state vectors would be %.1f bytes/frame",
+			static_cast<double>(stateSync.getEncodedBytes()) / stateSync.getEncodeCalls(),
+			static_cast<double>(stateSync.getLegacyBytes()) / stateSync.getEncodeCalls());
+
+	lastEncodedSize = output.size();
+	isStateSentThisFrame = messageSize > 0;
 	return output;
 }
 
@@ -338,7 +417,16 @@ void decode(const std::vector<std::byte>& data, unsigned int pos)
 	deserializeObject(data, pos, isGameEnded);
 	deserializeObject(data, pos, areStatsVisible);
 	deserializeObject(data, pos, isGameStarted);
-	deserializeObject(data, pos, gameObjectStates);
+
+	//Copy into the persistent staging buffer, no allocation once it has reached its size
+	uint32_t messageSize;
+	deserializeObject(data, pos, messageSize);
+	if (pos + messageSize > data.size())
+	{
+		Log::Warning("Truncated state sync message received");
+		return;
+	}
+	stateMessage.assign(data.begin() + pos, data.begin() + pos + messageSize);
 }
 
 void cleanup()
@@ -354,17 +442,38 @@ void postSyncPreDraw()
 	{
 		Engine::instance().setStatsGraphVisibility(areStatsVisible);
 
-		if (!isGameStarted || isGameEnded)
-			return;
-		else if(gameObjectStates.size() > 0 && !isGameEnded) {
-			Game::instance().setSyncableData(std::move(gameObjectStates));
+		//Every message has to be applied, later deltas build on it
+		//Master only sends at the sync rate, frames in between have an empty message
+		const double time = Engine::getTime();
+		if (!stateMessage.empty())
+		{
+			unsigned int pos = 0;
+			if (!stateSync.decode(Game::instance().getSimulation(), stateMessage, pos, time))
+				Log::Warning("Malformed state sync message received");
+			stateMessage.clear();
 		}
+
+		//Positions are blended between the last received states every frame
+		stateSync.interpolate(Game::instance().getSimulation(), time);
 	}
 	else
 	{
-		if (isGameStarted)
-			Game::instance().sendPointsToServer(wsHandler);
+		//New players' colours, changed scores and the timer, at most two messages
+		Game::instance().sendUpdatesToServer(
+			[](const std::byte* data, size_t size) { queueServerMessage(data, size); });
+
+		//Past the cluster sync of this frame, input simulated before it is on the nodes
+		if (isStateSentThisFrame)
+			Game::instance().getSimulation().getInputLatency().markSynced(InputLatency::now());
+
+		//The nodes blend synced states themselves, see StateSync::interpolate
+		if (interpolateSteps)
+			Game::instance().getSimulation().beginRenderBlend();
 	}
+
+	//State for this frame is final on all nodes now, shared by every viewport
+	if (Game::exists())
+		Game::instance().prepareRender();
 }
 
 void connectionEstablished()
@@ -379,57 +488,70 @@ void connectionClosed()
 
 void messageReceived(const void* data, size_t length)
 {
-	std::string_view msg = std::string_view(reinterpret_cast<const char*>(data), length);
-	//Log::Info("Message received: %s", msg.data());
+	ZoneScoped;
+	//Decoded in place from the libwebsockets buffer, see inputprotocol.hpp for the formats
+	InputMessage message;
+	if (!InputProtocol::decode(data, length, message))
+		return;
 
-	std::string message = msg.data();
+	const int64_t receiveTime = std::chrono::duration_cast<std::chrono::microseconds>(
+		wsHandler->receiveTime().time_since_epoch()).count();
+	Game::instance().getSimulation().getInputLatency().record(InputLatency::Relay,
+		message.mRelayTime, receiveTime);
+	inputReceived(message, receiveTime);
+}
 
-	if (!message.empty())
-	{
-		//Get an easily manipulated stream of the message and read type of message
-		std::istringstream iss(message);
-		char msgType;
-		iss >> msgType;
-
-		// If first slot is 'N', a name and unique ID has been sent
-		if (msgType == 'N') {
-			Log::Info("Player connected: %s", message.c_str());
-			Game::instance().addPlayer(Utility::getNewPlayerData(iss));
-		}
+//Player messages from the relay or the PhoneServer
+void inputReceived(const InputMessage& message, int64_t receiveTime)
+{
+	// If first slot is 'N', a name and unique ID has been sent
+	if (message.mType == 'N') {
+		Log::Info("Player connected: %u %.*s", message.mPlayerId,
+			static_cast<int>(message.mName.size()), message.mName.data());
+		Game::instance().addPlayer(std::make_tuple(message.mPlayerId, std::string(message.mName)));
+	}
 
-		// If first slot is 'C', the rotation angle has been sent
-		if (msgType == 'C') {
-			Game::instance().updateTurnSpeed(Utility::getTurnSpeed(iss));
-		}
+	// If first slot is 'C', the rotation angle has been sent
+	if (message.mType == 'C') {
+		Game::instance().stageTurnSpeed(message.mPlayerId, message.mValue, message.mSequence,
+			message.mHasSequence, receiveTime);
+	}
 
+	// If first slot is 'D', player to be deleted has been sent
+	if (message.mType == 'D') {
+		Log::Info("Player disabled: %u", message.mPlayerId);
+		Game::instance().disablePlayer(message.mPlayerId);
+	}
 
-        // If first slot is 'D', player to be deleted has been sent
-        if (msgType == 'D') {
-            unsigned int playerId;
-            iss >> playerId;
-            Log::Info("Player disabled: %s", message.c_str());
-            Game::instance().disablePlayer(playerId);
-        }
-
-        // If first slot is 'E', player to be enabled has been sent
-        if (msgType == 'E') {
-            Log::Info("Player enabled: %s", message.c_str());
-            unsigned int playerId;
-            iss >> playerId;
-            Game::instance().enablePlayer(playerId);
-        }
-
-        // If first slot is 'I', player's ID has been sent
-        if (msgType == 'I') {
-            unsigned int playerId;
-            iss >> playerId;
-            // Send colour information back to server
-            std::pair<glm::vec3, glm::vec3> colours = Game::instance().getPlayerColours(playerId);
-            std::string colourOne = glm::to_string(colours.first);
-            std::string colourTwo = glm::to_string(colours.second);
-
-            wsHandler->queueMessage("A " + colourOne + " " + std::to_string(playerId));
-            wsHandler->queueMessage("B " + colourTwo + " " + std::to_string(playerId));
-        }
+	// If first slot is 'E', player to be enabled has been sent
+	if (message.mType == 'E') {
+		Log::Info("Player enabled: %u", message.mPlayerId);
+		Game::instance().enablePlayer(message.mPlayerId);
 	}
+
+	// If first slot is 'I', player's ID has been sent
+	if (message.mType == 'I') {
+		// Colours go back to the server in the next roster message
+		Game::instance().addToRoster(message.mPlayerId);
+	}
+
+	// If first slot is 'Y', send the token straight back for round trip measurements
+	if (message.mType == 'Y') {
+		ServerMessages::encodeEcho(message.mPlayerId, message.mName, echoMessage);
+		queueServerMessage(echoMessage.data(), echoMessage.size());
+	}
+}
+
+//Messages for the phones, through the relay or straight from the PhoneServer
+void queueServerMessage(const std::byte* data, size_t size)
+{
+	if (wsHandler)
+		wsHandler->queueMessage(data, size);
+	else if (phoneServer)
+		phoneServer->queueMessage(data, size);
+}
+
+void queueServerMessage(const std::string& message)
+{
+	queueServerMessage(reinterpret_cast<const std::byte*>(message.data()), message.size());
 }
@@ -19,6 +19,33 @@ void Mesh::render() const
 	glBindVertexArray(0);
 }
 
+void Mesh::renderInstanced(GLuint instanceBuffer, const InstanceLayout& layout,
+                           size_t firstInstance, GLsizei count) const
+{
+	glBindTexture(GL_TEXTURE_2D, mTextures[0].mId);
+
+	glBindVertexArray(VAO);
+
+	//Point the instance attributes at this model's range of the shared buffer
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	const size_t offset = firstInstance * layout.mStride;
+	for (const InstanceLayout::Attribute& a : layout.mAttributes)
+	{
+		glEnableVertexAttribArray(a.mLocation);
+		glVertexAttribPointer(a.mLocation, a.mComponents, GL_FLOAT, GL_FALSE, layout.mStride,
+			(void*)(offset + a.mOffset));
+		glVertexAttribDivisor(a.mLocation, 1);
+	}
+
+	glDrawElementsInstanced(GL_TRIANGLES, mIndices.size(), GL_UNSIGNED_INT, nullptr, count);
+
+	//Leave the VAO as the non-instanced path expects it
+	for (const InstanceLayout::Attribute& a : layout.mAttributes)
+		glDisableVertexAttribArray(a.mLocation);
+
+	glBindVertexArray(0);
+}
+
 void Mesh::uploadMeshToGPU()
 {
 	glGenVertexArrays(1, &VAO);
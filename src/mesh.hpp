@@ -19,6 +19,21 @@ struct Texture
 	std::string mPath;
 };
 
+//How per-instance data is laid out in an instance buffer
+//Every attribute is made of floats, a mat4 takes four attributes (one per column)
+struct InstanceLayout
+{
+	struct Attribute
+	{
+		GLuint mLocation;
+		GLint mComponents;
+		size_t mOffset;
+	};
+
+	std::vector<Attribute> mAttributes;
+	GLsizei mStride = 0;
+};
+
 //This class was written with help of tutorial 
 //https://learnopengl.com/Model-Loading/Assimp
 class Mesh
@@ -29,6 +44,11 @@ public:
 
 	//Render mesh
 	void render() const;
+
+	//Render count instances with per-instance data read from instanceBuffer as described
+	//by layout, starting at instance firstInstance
+	void renderInstanced(GLuint instanceBuffer, const InstanceLayout& layout,
+	                     size_t firstInstance, GLsizei count) const;
 private:
 	//Mesh data
 	std::vector<Vertex> mVertices;
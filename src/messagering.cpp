@@ -0,0 +1,58 @@
+#include "messagering.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "sgct/log.h"
+#include "sgct/profiling.h"
+
+MessageRing::MessageRing(size_t capacity, size_t padding)
+	: mBuffer(padding + capacity), mPadding{ padding }, mWrite{ padding }
+{
+}
+
+void MessageRing::push(const std::byte* data, size_t size)
+{
+	ZoneScoped;
+	if (size > mMAXMESSAGESIZE)
+	{
+		sgct::Log::Error("Outgoing message of %zu bytes is too long to be sent", size);
+		return;
+	}
+	const size_t needed = mPREFIXSIZE + size;
+	if (mWrite + needed > mBuffer.size())
+		grow(needed);
+
+	mBuffer[mWrite] = std::byte(size & 0xFF);
+	mBuffer[mWrite + 1] = std::byte(size >> 8);
+	std::memcpy(mBuffer.data() + mWrite + mPREFIXSIZE, data, size);
+	mWrite += needed;
+	++mNumMessages;
+}
+
+std::byte* MessageRing::frontBatch(size_t& size)
+{
+	if (empty())
+	{
+		size = 0;
+		return nullptr;
+	}
+
+	size = mWrite - mPadding;
+	return mBuffer.data() + mPadding;
+}
+
+void MessageRing::popBatch()
+{
+	//Everything pending went out in the batch, start over at the front
+	mWrite = mPadding;
+	mNumMessages = 0;
+}
+
+void MessageRing::grow(size_t minFree)
+{
+	ZoneScoped;
+	//The pending messages stay at the front, resize keeps them in place
+	mBuffer.resize(mPadding + std::max(2 * capacity(), capacity() + minFree));
+	sgct::Log::Warning("Outgoing message queue grown to %zu bytes", capacity());
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+//Outgoing messages in one preallocated buffer of bytes, read back as a single batch
+//Each message is stored once after its length (mPREFIXSIZE bytes, little endian), so
+//all messages queued since the last write come out as one contiguous batch of frames
+//mPadding bytes before the batch belong to the reader (LWS_PRE for libwebsockets),
+//the writer never puts pending messages there
+//The batch is always taken whole, so the writer starts over at the front after each one
+//The buffer grows if a burst does not fit
+class MessageRing
+{
+public:
+	static constexpr size_t mPREFIXSIZE = 2;
+	static constexpr size_t mMAXMESSAGESIZE = 0xFFFF;
+
+	MessageRing(size_t capacity, size_t padding);
+
+	//Messages longer than mMAXMESSAGESIZE are dropped with an error
+	void push(const std::byte* data, size_t size);
+
+	//All pending messages as one batch of frames, nullptr if empty
+	//Writing to the mPadding bytes before the returned pointer is allowed
+	std::byte* frontBatch(size_t& size);
+	//Remove the messages returned by the last frontBatch
+	void popBatch();
+
+	bool empty() const { return mNumMessages == 0; }
+	size_t size() const { return mNumMessages; }
+	size_t capacity() const { return mBuffer.size() - mPadding; }
+
+private:
+	//Make room for minFree more bytes after the pending ones
+	void grow(size_t minFree);
+
+	std::vector<std::byte> mBuffer;
+	size_t mPadding;
+
+	//Pending bytes are [mPadding, mWrite)
+	size_t mWrite;
+	size_t mNumMessages = 0;
+};
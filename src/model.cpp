@@ -13,6 +13,15 @@ void Model::render() const
     }
 }
 
+void Model::renderInstanced(GLuint instanceBuffer, const InstanceLayout& layout,
+                            size_t firstInstance, GLsizei count) const
+{
+    for (const Mesh& m : mMeshes)
+    {
+        m.renderInstanced(instanceBuffer, layout, firstInstance, count);
+    }
+}
+
 void Model::loadModel(const std::string& path)
 {
     Assimp::Importer import;
@@ -23,6 +23,10 @@ public:
 	//Render model
 	void render() const;
 
+	//Render count instances of the model, see Mesh::renderInstanced
+	void renderInstanced(GLuint instanceBuffer, const InstanceLayout& layout,
+	                     size_t firstInstance, GLsizei count) const;
+
 private:
 	//Model data
 	std::vector<Mesh> mMeshes;
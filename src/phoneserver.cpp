@@ -0,0 +1,350 @@
+#include "phoneserver.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+#include "libwebsockets.h"
+#include "sgct/log.h"
+#include "sgct/profiling.h"
+
+#include "inputlatency.hpp"
+#include "servermessages.hpp"
+
+struct PhoneServer::Setup
+{
+	lws_protocols mProtocols[2];
+	lws_http_mount mFiles;
+	lws_http_mount mConfig;
+};
+
+namespace
+{
+	//Phones connect without asking for a protocol and get the first one
+	constexpr const char* PhoneProtocol = "phone";
+
+	int serviceCallback(lws* wsi, lws_callback_reasons reason, void* user, void* in, size_t len)
+	{
+		return PhoneServer::callback(wsi, reason, user, in, len);
+	}
+
+	template<typename T>
+	T readLittleEndian(const std::byte* data)
+	{
+		T value;
+		std::memcpy(&value, data, sizeof(T));
+		return value;
+	}
+
+	std::string colourText(char type, const std::byte* rgb)
+	{
+		return std::string(1, type) + ' ' + std::to_string(std::to_integer<int>(rgb[0])) + ','
+			+ std::to_string(std::to_integer<int>(rgb[1])) + ','
+			+ std::to_string(std::to_integer<int>(rgb[2]));
+	}
+}
+
+PhoneServer::PhoneServer(int port, std::string publicDir, InputCallback onInput)
+	: mPort(port), mPublicDir(std::move(publicDir)), mOnInput(std::move(onInput))
+{
+}
+
+PhoneServer::~PhoneServer()
+{
+	if (mContext)
+		lws_context_destroy(mContext);
+}
+
+bool PhoneServer::start()
+{
+	ZoneScoped;
+	mSetup = std::make_unique<Setup>();
+	std::memset(mSetup.get(), 0, sizeof(Setup));
+
+	mSetup->mProtocols[0].name = PhoneProtocol;
+	mSetup->mProtocols[0].callback = serviceCallback;
+	mSetup->mProtocols[0].rx_buffer_size = 1024;
+
+	//Everything but /config is a file of the phone page
+	mSetup->mFiles.mount_next = &mSetup->mConfig;
+	mSetup->mFiles.mountpoint = "/";
+	mSetup->mFiles.mountpoint_len = 1;
+	mSetup->mFiles.origin = mPublicDir.c_str();
+	mSetup->mFiles.def = "index.html";
+	mSetup->mFiles.origin_protocol = LWSMPRO_FILE;
+
+	mSetup->mConfig.mountpoint = "/config";
+	mSetup->mConfig.mountpoint_len = 7;
+	mSetup->mConfig.origin = PhoneProtocol;
+	mSetup->mConfig.origin_protocol = LWSMPRO_CALLBACK;
+
+	lws_context_creation_info info;
+	std::memset(&info, 0, sizeof(info));
+	info.port = mPort;
+	info.protocols = mSetup->mProtocols;
+	info.mounts = &mSetup->mFiles;
+	info.gid = -1;
+	info.uid = -1;
+	info.user = this;
+
+	mContext = lws_create_context(&info);
+	if (!mContext)
+	{
+		sgct::Log::Error("Phone server could not listen on port %d", mPort);
+		return false;
+	}
+	sgct::Log::Info("Phone server listening on port %d, serving %s", mPort, mPublicDir.c_str());
+	return true;
+}
+
+void PhoneServer::tick()
+{
+	ZoneScoped;
+	if (mContext)
+		lws_service(mContext, 0);
+}
+
+int PhoneServer::callback(lws* wsi, int reason, void* user, void* in, size_t len)
+{
+	PhoneServer* server = static_cast<PhoneServer*>(lws_context_user(lws_get_context(wsi)));
+	if (!server)
+		return lws_callback_http_dummy(wsi, static_cast<lws_callback_reasons>(reason), user, in, len);
+
+	switch (reason)
+	{
+	case LWS_CALLBACK_HTTP:
+	{
+		//Only /config is mounted on this protocol. The body is small enough to go out
+		//in the same write as the headers
+		const std::string body = server->configJson(wsi);
+		unsigned char buffer[LWS_PRE + 512];
+		unsigned char* start = buffer + LWS_PRE;
+		unsigned char* p = start;
+		unsigned char* end = buffer + sizeof(buffer) - body.size();
+		const char* type = "application/json";
+		if (lws_add_http_header_status(wsi, HTTP_STATUS_OK, &p, end) ||
+			lws_add_http_header_by_token(wsi, WSI_TOKEN_HTTP_CONTENT_TYPE,
+				reinterpret_cast<const unsigned char*>(type), static_cast<int>(std::strlen(type)), &p, end) ||
+			lws_add_http_header_content_length(wsi, body.size(), &p, end) ||
+			lws_finalize_http_header(wsi, &p, end))
+			return 1;
+
+		std::memcpy(p, body.data(), body.size());
+		p += body.size();
+		lws_write(wsi, start, p - start, LWS_WRITE_HTTP_HEADERS);
+		return lws_http_transaction_completed(wsi) ? -1 : 0;
+	}
+	case LWS_CALLBACK_ESTABLISHED:
+		server->mSessions.emplace(wsi, Session{});
+		server->mSessions[wsi].mOutbox.push_back("Connected");
+		lws_callback_on_writable(wsi);
+		return 0;
+	case LWS_CALLBACK_RECEIVE:
+		//Phone messages are a few bytes, anything fragmented is not from the phone page
+		if (lws_is_first_fragment(wsi) && lws_is_final_fragment(wsi))
+			server->receive(wsi, static_cast<const char*>(in), len);
+		return 0;
+	case LWS_CALLBACK_SERVER_WRITEABLE:
+		return server->write(wsi) ? 0 : -1;
+	case LWS_CALLBACK_CLOSED:
+		server->disconnect(wsi);
+		return 0;
+	default:
+		//Serves the files of the mount
+		return lws_callback_http_dummy(wsi, static_cast<lws_callback_reasons>(reason), user, in, len);
+	}
+}
+
+void PhoneServer::receive(lws* wsi, const char* data, size_t len)
+{
+	ZoneScoped;
+	const int64_t receiveTime = InputLatency::now();
+	const std::string_view text(data, len);
+	if (text.size() < 3 || text[1] != ' ')
+		return;
+
+	auto session = mSessions.find(wsi);
+	if (session == mSessions.end())
+		return;
+
+	InputMessage message;
+	message.mType = text[0];
+
+	//"N name", the name is the first word as with the relay
+	if (message.mType == 'N' && !session->second.mHasJoined)
+	{
+		const std::string_view name = text.substr(2, text.find(' ', 2) - 2);
+		session->second.mPlayerId = mNextId++;
+		session->second.mHasJoined = true;
+		mPlayers[session->second.mPlayerId] = wsi;
+
+		message.mPlayerId = session->second.mPlayerId;
+		message.mName = name;
+		mOnInput(message, receiveTime);
+
+		//The player's colours come back in the next roster
+		message.mType = 'I';
+		message.mName = {};
+		mOnInput(message, receiveTime);
+	}
+	//"C turn speed"
+	else if (message.mType == 'C' && session->second.mHasJoined)
+	{
+		//strtof needs a terminated string, copy the number to the stack
+		char number[32];
+		const size_t length = std::min(text.size() - 2, sizeof(number) - 1);
+		std::memcpy(number, text.data() + 2, length);
+		number[length] = '\0';
+
+		char* end;
+		message.mValue = std::strtof(number, &end);
+		if (end == number)
+			return;
+
+		message.mPlayerId = session->second.mPlayerId;
+		mOnInput(message, receiveTime);
+	}
+	//"Y token", echoed by the game
+	else if (message.mType == 'Y' && session->second.mHasJoined)
+	{
+		message.mPlayerId = session->second.mPlayerId;
+		message.mName = text.substr(2);
+		mOnInput(message, receiveTime);
+	}
+}
+
+void PhoneServer::disconnect(lws* wsi)
+{
+	auto session = mSessions.find(wsi);
+	if (session == mSessions.end())
+		return;
+
+	if (session->second.mHasJoined)
+	{
+		InputMessage message;
+		message.mType = 'D';
+		message.mPlayerId = session->second.mPlayerId;
+		mPlayers.erase(message.mPlayerId);
+		mOnInput(message, InputLatency::now());
+		sgct::Log::Info("Phone of player %u disconnected", message.mPlayerId);
+	}
+	mSessions.erase(session);
+}
+
+bool PhoneServer::write(lws* wsi)
+{
+	ZoneScoped;
+	auto session = mSessions.find(wsi);
+	if (session == mSessions.end() || session->second.mOutbox.empty())
+		return true;
+
+	//One text message per write, the phone page handles each on its own
+	const std::string& text = session->second.mOutbox.front();
+	mWriteBuffer.resize(LWS_PRE + text.size());
+	std::memcpy(mWriteBuffer.data() + LWS_PRE, text.data(), text.size());
+	const int written = lws_write(wsi, mWriteBuffer.data() + LWS_PRE, text.size(), LWS_WRITE_TEXT);
+	session->second.mOutbox.pop_front();
+
+	if (!session->second.mOutbox.empty())
+		lws_callback_on_writable(wsi);
+	return written >= 0;
+}
+
+std::string PhoneServer::configJson(lws* wsi) const
+{
+	//The host header may carry a port, the page adds serverPort itself
+	char host[128] = "localhost";
+	if (lws_hdr_copy(wsi, host, sizeof(host), WSI_TOKEN_HOST) > 0)
+	{
+		char* bracket = std::strchr(host, ']');
+		char* colon = std::strrchr(host, ':');
+		if (colon && (!bracket || colon > bracket))
+			*colon = '\0';
+	}
+	return std::string("{\"serverAddress\":\"ws://") + host + "\",\"serverPort\":\""
+		+ std::to_string(mPort) + "\"}";
+}
+
+void PhoneServer::queueMessage(const std::byte* data, size_t size)
+{
+	ZoneScoped;
+	if (size == 0)
+		return;
+
+	const char type = std::to_integer<char>(data[0]);
+	if (type == 'S' && size >= ServerMessages::mSCOREBOARDHEADER)
+	{
+		//Changed scores go to their players, the timer to everyone
+		const uint16_t count = readLittleEndian<uint16_t>(data + 2);
+		if (size < ServerMessages::mSCOREBOARDHEADER + count * ServerMessages::mSCOREBOARDENTRY)
+			return;
+
+		const std::byte* entry = data + ServerMessages::mSCOREBOARDHEADER;
+		for (uint16_t i = 0; i < count; i++, entry += ServerMessages::mSCOREBOARDENTRY)
+		{
+			sendToPlayer(readLittleEndian<uint16_t>(entry),
+				"P " + std::to_string(readLittleEndian<int32_t>(entry + 2)));
+		}
+
+		if (std::to_integer<uint8_t>(data[1]) & 1)
+		{
+			char time[32];
+			std::snprintf(time, sizeof(time), "T %.2f", readLittleEndian<float>(data + 4));
+			broadcast(time);
+		}
+	}
+	else if (type == 'R' && size >= ServerMessages::mROSTERHEADER)
+	{
+		//Colours of new players, as "A r,g,b" and "B r,g,b" to each of them
+		const uint16_t count = readLittleEndian<uint16_t>(data + 2);
+		if (size < ServerMessages::mROSTERHEADER + count * ServerMessages::mROSTERENTRY)
+			return;
+
+		const std::byte* entry = data + ServerMessages::mROSTERHEADER;
+		for (uint16_t i = 0; i < count; i++, entry += ServerMessages::mROSTERENTRY)
+		{
+			const uint16_t id = readLittleEndian<uint16_t>(entry);
+			sendToPlayer(id, colourText('A', entry + 2));
+			sendToPlayer(id, colourText('B', entry + 5));
+		}
+	}
+	else if (type == 'Y' && size >= ServerMessages::mECHOHEADER)
+	{
+		sendToPlayer(readLittleEndian<uint16_t>(data + 2), "Y " + std::string(
+			reinterpret_cast<const char*>(data + ServerMessages::mECHOHEADER), size - ServerMessages::mECHOHEADER));
+	}
+	else
+	{
+		broadcast(std::string(reinterpret_cast<const char*>(data), size));
+	}
+}
+
+void PhoneServer::queueMessage(const std::string& message)
+{
+	queueMessage(reinterpret_cast<const std::byte*>(message.data()), message.size());
+}
+
+void PhoneServer::sendToPlayer(uint32_t id, std::string text)
+{
+	auto player = mPlayers.find(id);
+	if (player == mPlayers.end())
+		return;
+
+	std::deque<std::string>& outbox = mSessions[player->second].mOutbox;
+	if (outbox.size() >= mMAXOUTBOX)
+		outbox.pop_front();
+	outbox.push_back(std::move(text));
+	lws_callback_on_writable(player->second);
+}
+
+void PhoneServer::broadcast(const std::string& text)
+{
+	for (auto& [wsi, session] : mSessions)
+	{
+		if (session.mOutbox.size() >= mMAXOUTBOX)
+			session.mOutbox.pop_front();
+		session.mOutbox.push_back(text);
+		lws_callback_on_writable(wsi);
+	}
+}
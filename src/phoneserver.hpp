@@ -0,0 +1,90 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
+
+#include "inputprotocol.hpp"
+
+struct lws;
+struct lws_context;
+
+//WebSocket and web server for the phones, run on the master in place of webserver/server.js
+//Serves the files of the phone page and accepts its connections directly, so input does
+//not take the extra hop through the Node relay. Players get ids in the order they join
+//and the game sees the same N, I, C, D and Y messages as from the relay, with no relay time
+//
+//Messages for the relay (ServerMessages and text like "U start") are routed to the
+//phones here instead, as the text messages the phone page expects
+//Everything happens on the thread calling tick and queueMessage
+class PhoneServer
+{
+public:
+	//Called for every player message, receiveTime is when it was read from the socket in
+	//microseconds on InputLatency::now()
+	using InputCallback = std::function<void(const InputMessage& message, int64_t receiveTime)>;
+
+	//Serve the files in publicDir on port, it needs an absolute path
+	PhoneServer(int port, std::string publicDir, InputCallback onInput);
+	~PhoneServer();
+
+	//Start listening, returns false if the port could not be opened
+	bool start();
+
+	//Accept connections, read and send messages, once per frame
+	void tick();
+
+	//Route a message for the relay to the phones
+	void queueMessage(const std::byte* data, size_t size);
+	void queueMessage(const std::string& message);
+
+	size_t getNumConnections() const { return mSessions.size(); }
+
+	//libwebsockets callback of the phone protocol, reason is a lws_callback_reasons
+	static int callback(lws* wsi, int reason, void* user, void* in, size_t len);
+
+private:
+	//A connected phone and the messages waiting until its socket can be written to
+	struct Session
+	{
+		uint32_t mPlayerId = 0;
+		bool mHasJoined = false;
+		std::deque<std::string> mOutbox;
+	};
+
+	void receive(lws* wsi, const char* data, size_t len);
+	void disconnect(lws* wsi);
+	bool write(lws* wsi);
+
+	//Answer for the page's /config request, the address to connect back to is the host
+	//the page was loaded from
+	std::string configJson(lws* wsi) const;
+
+	void sendToPlayer(uint32_t id, std::string text);
+	void broadcast(const std::string& text);
+
+	//Slow phones lose their oldest messages beyond this
+	static constexpr size_t mMAXOUTBOX = 256;
+
+	//Protocol and mount tables, libwebsockets keeps pointers to them
+	struct Setup;
+	std::unique_ptr<Setup> mSetup;
+
+	int mPort;
+	std::string mPublicDir;
+	InputCallback mOnInput;
+	lws_context* mContext = nullptr;
+
+	std::unordered_map<lws*, Session> mSessions;
+	//Connection of each player that joined, by player id
+	std::unordered_map<uint32_t, lws*> mPlayers;
+	uint32_t mNextId = 0;
+
+	//Messages are copied here behind the LWS_PRE padding before they are written
+	std::vector<unsigned char> mWriteBuffer;
+};
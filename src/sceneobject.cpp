@@ -1,8 +1,8 @@
 #include "sceneobject.hpp"
 
-SceneObject::SceneObject(const std::string & objectModelName,
+SceneObject::SceneObject(EntityStore& store, const std::string & objectModelName,
 	                     float radius, const glm::quat& position, const float orientation)
-	: GameObject{ GameObject::SCENEOBJECT, radius, position, orientation, 5.f }, GeometryHandler("sceneobject", objectModelName)
+	: GameObject{ store, GameObject::SCENEOBJECT, radius, position, orientation, 5.f }, GeometryHandler("sceneobject", objectModelName)
 {
 	mShaderProgram.bind();
 
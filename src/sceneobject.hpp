@@ -11,7 +11,7 @@ class SceneObject : public GameObject, private GeometryHandler
 {
 public:
 	//Ctor
-	SceneObject(const std::string & objectModelName,
+	SceneObject(EntityStore& store, const std::string & objectModelName,
 	            float radius, const glm::quat & position, const float orientation);
 
 	//Render
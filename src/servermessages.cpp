@@ -0,0 +1,73 @@
+#include "servermessages.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "sgct/profiling.h"
+
+namespace
+{
+	template<typename T>
+	void writeLittleEndian(std::byte* data, T value)
+	{
+		std::memcpy(data, &value, sizeof(T));
+	}
+
+	std::byte colourByte(float component)
+	{
+		return std::byte(static_cast<uint8_t>(std::clamp(component, 0.f, 1.f) * 255.f + 0.5f));
+	}
+}
+
+void ServerMessages::encodeScoreboard(const std::vector<std::pair<unsigned, int>>& points,
+	bool hasTime, float passedTime, std::vector<std::byte>& output)
+{
+	ZoneScoped;
+	output.resize(mSCOREBOARDHEADER + mSCOREBOARDENTRY * points.size());
+	std::byte* data = output.data();
+	data[0] = std::byte('S');
+	data[1] = std::byte(hasTime ? 1 : 0);
+	writeLittleEndian(data + 2, static_cast<uint16_t>(points.size()));
+	writeLittleEndian(data + 4, passedTime);
+
+	data += mSCOREBOARDHEADER;
+	for (const std::pair<unsigned, int>& entry : points)
+	{
+		writeLittleEndian(data, static_cast<uint16_t>(entry.first));
+		writeLittleEndian(data + 2, static_cast<int32_t>(entry.second));
+		data += mSCOREBOARDENTRY;
+	}
+}
+
+void ServerMessages::encodeRoster(const std::vector<std::pair<unsigned, std::pair<glm::vec3, glm::vec3>>>& colours,
+	std::vector<std::byte>& output)
+{
+	ZoneScoped;
+	output.resize(mROSTERHEADER + mROSTERENTRY * colours.size());
+	std::byte* data = output.data();
+	data[0] = std::byte('R');
+	data[1] = std::byte(0);
+	writeLittleEndian(data + 2, static_cast<uint16_t>(colours.size()));
+
+	data += mROSTERHEADER;
+	for (const auto& [id, pair] : colours)
+	{
+		writeLittleEndian(data, static_cast<uint16_t>(id));
+		for (int c = 0; c < 3; c++)
+		{
+			data[2 + c] = colourByte(pair.first[c]);
+			data[5 + c] = colourByte(pair.second[c]);
+		}
+		data += mROSTERENTRY;
+	}
+}
+
+void ServerMessages::encodeEcho(unsigned id, std::string_view token, std::vector<std::byte>& output)
+{
+	output.resize(mECHOHEADER + token.size());
+	std::byte* data = output.data();
+	data[0] = std::byte('Y');
+	data[1] = std::byte(0);
+	writeLittleEndian(data + 2, static_cast<uint16_t>(id));
+	std::memcpy(data + mECHOHEADER, token.data(), token.size());
+}
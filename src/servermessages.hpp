@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+#include "glm/glm.hpp"
+
+//Binary messages from the game to webserver/server.js, which fans them out to the phones
+//by player id. All values little endian
+//
+//Scoreboard, at most one per frame with every score that changed and the timer:
+//  u8 'S', u8 flags (bit 0: timer included), u16 count, f32 passed time (fraction)
+//  count x (u16 player id, i32 total points)
+//Roster, the colours of players that joined since the last one:
+//  u8 'R', u8 unused, u16 count
+//  count x (u16 player id, u8 primary r g b, u8 secondary r g b)
+//Echo, the answer to a Y message from a phone, for measuring round trips:
+//  u8 'Y', u8 unused, u16 player id, the token of the Y message
+class ServerMessages
+{
+public:
+	static constexpr size_t mSCOREBOARDHEADER = 8;
+	static constexpr size_t mSCOREBOARDENTRY = 6;
+	static constexpr size_t mROSTERHEADER = 4;
+	static constexpr size_t mROSTERENTRY = 8;
+	static constexpr size_t mECHOHEADER = 4;
+
+	//Replace the content of output with a scoreboard of points, as (id, total points)
+	static void encodeScoreboard(const std::vector<std::pair<unsigned, int>>& points,
+		bool hasTime, float passedTime, std::vector<std::byte>& output);
+
+	//Replace the content of output with a roster of (id, (primary, secondary)) colours
+	//Colour components are in [0, 1] and sent as bytes
+	static void encodeRoster(const std::vector<std::pair<unsigned, std::pair<glm::vec3, glm::vec3>>>& colours,
+		std::vector<std::byte>& output);
+
+	//Replace the content of output with an echo of token to player id
+	static void encodeEcho(unsigned id, std::string_view token, std::vector<std::byte>& output);
+};
@@ -0,0 +1,26 @@
+#version 330 core
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 texCoord;
+
+// Per-instance transformation, takes locations 3-6
+layout(location = 3) in mat4 transformation;
+
+uniform mat4 mvp;
+uniform mat4 view;
+uniform float time;
+
+out vec3 fragPos;
+out vec3 interpolatedNormal;
+out vec2 st;
+out vec3 light;
+
+
+void main() {
+	fragPos = vec3(transformation * vec4(position, 1.0));
+	// Models are only scaled uniformly, so the rotation part of the
+	// transformation works as normal matrix (the normal is normalized later)
+	interpolatedNormal = mat3(transformation) * normal;
+	st = texCoord;
+	gl_Position = mvp * vec4(fragPos, 1.0);
+}
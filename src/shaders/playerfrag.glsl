@@ -2,13 +2,14 @@
 
 uniform float time;
 uniform sampler2D tex;
-uniform vec3 primaryCol;
-uniform vec3 secondaryCol;
 uniform vec3 cameraPos;
 
 in vec2 st;
 in vec3 interpolatedNormal;
 in vec3 fragPos;
+// From uniforms or per-instance attributes, see playervert.glsl and playerinstancedvert.glsl
+flat in vec3 primaryColour;
+flat in vec3 secondaryColour;
 
 out vec4 color;
 
@@ -26,7 +27,7 @@ void main() {
 
     // Albedo colour
     float mask = vec4(texture(tex, st)).r;
-    vec4 albedo = (1.0 - mask) * vec4(primaryCol, 1.0) + mask * vec4(secondaryCol, 1.0);
+    vec4 albedo = (1.0 - mask) * vec4(primaryColour, 1.0) + mask * vec4(secondaryColour, 1.0);
 
     // Diffuse light
     vec3 nNormal = normalize(interpolatedNormal);
@@ -0,0 +1,31 @@
+#version 330 core
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 texCoord;
+
+// Per-instance data, transformation takes locations 3-6
+layout(location = 3) in mat4 transformation;
+layout(location = 7) in vec3 instancePrimaryCol;
+layout(location = 8) in vec3 instanceSecondaryCol;
+
+uniform mat4 mvp;
+uniform mat4 view;
+uniform float time;
+
+out vec3 fragPos;
+out vec3 interpolatedNormal;
+out vec2 st;
+out vec3 light;
+flat out vec3 primaryColour;
+flat out vec3 secondaryColour;
+
+
+void main() {
+	fragPos = vec3(transformation * vec4(position, 1.0));
+	// Normal matrix as in collectibleinstancedvert.glsl
+	interpolatedNormal = mat3(transformation) * normal;
+	st = texCoord;
+	primaryColour = instancePrimaryCol;
+	secondaryColour = instanceSecondaryCol;
+	gl_Position = mvp * vec4(fragPos, 1.0);
+}
@@ -8,16 +8,22 @@ uniform mat4 transformation;
 uniform mat4 view;
 uniform mat3 normalMatrix;
 uniform float time;
+uniform vec3 primaryCol;
+uniform vec3 secondaryCol;
 
 out vec3 fragPos;
 out vec3 interpolatedNormal;
 out vec2 st;
 out vec3 light;
+flat out vec3 primaryColour;
+flat out vec3 secondaryColour;
 
 
 void main() {
 	fragPos = vec3(transformation * vec4(position, 1.0));
 	interpolatedNormal = normalMatrix * normal;
 	st = texCoord;
+	primaryColour = primaryCol;
+	secondaryColour = secondaryCol;
 	gl_Position = mvp * vec4(fragPos, 1.0);
 }
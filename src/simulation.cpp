@@ -0,0 +1,459 @@
+#include "simulation.hpp"
+
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+
+#include <glm/gtc/constants.hpp>
+
+#include "constants.hpp"
+#include "inputprotocol.hpp"
+
+// Note that this can be set by setConstraints(...)
+BallJointConstraint Simulation::mConstraint = BallJointConstraint{ 163.0f, 0.0f };
+
+void Simulation::init(size_t maxPlayers, size_t maxCollectibles, unsigned seed)
+{
+	ZoneScoped;
+	if (seed == 0)
+		seed = std::random_device{}();
+	mPosGenerator.init(seed);
+	mColourSelector.shuffle(seed);
+
+	mPlayerCapacity = 0;
+	mPlayerChunk = std::clamp<size_t>(maxPlayers, 1, mMAXENTITIES);
+	reservePlayers(mPlayerChunk);
+
+	//Collectibles alternate between all trash models, model slots are the indices
+	//into allModelNames that ModelManager loads them at
+	mTrashModels.clear();
+	for (size_t m = 0; m < allModelNames.size(); m++)
+	{
+		const std::string& name = allModelNames[m];
+		if (name == "fish" || name == "diver" || name == "background")
+			continue;
+
+		mTrashModels.push_back(static_cast<uint8_t>(m));
+	}
+
+	mCollectibleHandles.init(0);
+	mCollectibleChunk = std::clamp<size_t>(maxCollectibles, 1, mMAXENTITIES);
+	growCollectibles(mCollectibleChunk);
+}
+
+size_t Simulation::addPlayer(const std::string& name, const glm::quat& position, float orientation,
+                             float speed)
+{
+	const size_t id = addPlayer(name, mColourSelector.getNextPair());
+	mPlayerStates.setPosition(id, position);
+	mPlayerStates.setOrientation(id, orientation);
+	mPlayerStates.mSpeeds[id] = speed;
+	return id;
+}
+
+size_t Simulation::addPlayer(const std::string& name, const std::pair<glm::vec3, glm::vec3>& colours)
+{
+	//Players can't be turned away, the capacity grows by another [Game] maxPlayers
+	if (mPlayers.size() == mPlayerCapacity)
+	{
+		reservePlayers(mPlayerCapacity + mPlayerChunk);
+		sgct::Log::Warning("Player capacity reached, grown to %zu players", mPlayerCapacity);
+		if (mPlayers.size() >= mMAXENTITIES)
+			sgct::Log::Warning("More than %zu players, the ones above are not synced to the nodes", mMAXENTITIES);
+	}
+
+	const glm::quat modelRotation = glm::quat(glm::vec3(glm::half_pi<float>(), 0.f, glm::pi<float>()));
+	const size_t id = mPlayerStates.add(glm::quat(1.f, 0.f, 0.f, 0.f), 0.f, modelRotation,
+		DOMERADIUS, PLAYERSCALE, mDEFAULTSPEED, mDEFAULTTURNSPEED);
+	mPlayers.push_back(PlayerInfo{ name, colours });
+	mSpawnScheduler.addSource(mSimulatedTime);
+	sgct::Log::Info("Player with name=\"%s\" created", name.c_str());
+	return id;
+}
+
+void Simulation::applyInput(const InputMessage& message, int64_t receiveTime)
+{
+	mInputLatency.record(InputLatency::Relay, message.mRelayTime, receiveTime);
+
+	if (message.mType == 'N')
+		addPlayer(std::string(message.mName));
+
+	if (message.mType == 'C')
+		stageTurnSpeed(message.mPlayerId, message.mValue, message.mSequence, message.mHasSequence, receiveTime);
+
+	if (message.mPlayerId >= mPlayers.size())
+		return;
+
+	if (message.mType == 'D' || message.mType == 'E')
+		setEnabled(message.mPlayerId, message.mType == 'E');
+}
+
+void Simulation::reservePlayers(size_t capacity)
+{
+	ZoneScoped;
+	mPlayerCapacity = capacity;
+	mPlayers.reserve(capacity);
+	mPlayerStates.reserve(capacity);
+	mInputStaging.grow(capacity);
+	mIdPoints.reserve(capacity);
+}
+
+size_t Simulation::growCollectibles(size_t count)
+{
+	ZoneScoped;
+	count = std::min(count, mMAXENTITIES - std::min(mMAXENTITIES, mCollectibleModels.size()));
+	const size_t capacity = mCollectibleModels.size() + count;
+
+	mCollectibleStates.reserve(capacity);
+	mCollectibleModels.reserve(capacity);
+	const glm::quat modelRotation = glm::quat(glm::vec3(glm::half_pi<float>(), 0.f, glm::pi<float>()));
+	for (size_t i = mCollectibleModels.size(); i < capacity; i++)
+	{
+		mCollectibleStates.add(glm::quat(glm::vec3(1.f, 0.f, 0.f)), 0.f, modelRotation,
+			DOMERADIUS, COLLECTIBLESCALE, 0.f, 0.f, false);
+		mCollectibleModels.push_back(mTrashModels[i % mTrashModels.size()]);
+	}
+
+	mCollectibleHandles.grow(capacity);
+	mCollectibleDirections.reserve(capacity);
+	mCollectibleGrid.reserve(capacity);
+	mCollectedThisTick.reserve(capacity);
+	mCollectedHandles.reserve(capacity);
+	return count;
+}
+
+HandlePool::Handle Simulation::enableCollectible(const glm::quat& pos)
+{
+	ZoneScoped;
+	//Out of slots, grow by another [Game] maxCollectibles unless the sync limit is reached
+	if (mNumCollectibles == mCollectibleModels.size())
+	{
+		if (growCollectibles(mCollectibleChunk) == 0)
+		{
+			if (!mIsCollectibleSaturated)
+				sgct::Log::Warning("All %zu collectibles are in use, spawns are skipped", mNumCollectibles);
+			mIsCollectibleSaturated = true;
+			return HandlePool::Handle{};
+		}
+		sgct::Log::Warning("Collectible capacity reached, grown to %zu collectibles", mCollectibleModels.size());
+	}
+
+	const HandlePool::Handle handle = mCollectibleHandles.add();
+	assert(mCollectibleHandles.size() == mNumCollectibles + 1 && "Collectible handles out of step with the store");
+	mCollectibleStates.setPosition(mNumCollectibles, pos);
+	mCollectibleStates.mEnabled[mNumCollectibles] = 1;
+
+	++mNumCollectibles;
+	return handle;
+}
+
+bool Simulation::disableCollectible(HandlePool::Handle handle)
+{
+	const size_t index = mCollectibleHandles.indexOf(handle);
+	if (index == HandlePool::npos)
+		return false;
+
+	disableCollectibleAndSwap(index);
+	return true;
+}
+
+void Simulation::disableCollectibleAndSwap(size_t index)
+{
+	ZoneScoped;
+	const size_t lastEnabled = mCollectibleHandles.removeAt(index);
+	assert(lastEnabled == mNumCollectibles - 1 && "Collectible handles out of step with the store");
+
+	//Move the state of the last enabled collectible into the hole
+	mCollectibleStates.swap(index, lastEnabled);
+	std::swap(mCollectibleModels[index], mCollectibleModels[lastEnabled]);
+
+	mCollectibleStates.mEnabled[lastEnabled] = 0;
+	--mNumCollectibles;
+	mIsCollectibleSaturated = false;
+}
+
+void Simulation::update(double time)
+{
+	if (!mIsStarted || mIsEnded)
+		return;
+
+	ZoneScoped;
+	//Input is applied once per update, only the newest turn speed of each player
+	const int64_t applyTime = InputLatency::now();
+	uint64_t numTimedInputs = 0;
+	mInputStaging.apply(mPlayers.size(), [&](size_t id, float turnSpeed, int64_t receiveTime) {
+		mPlayerStates.mTurnSpeeds[id] = turnSpeed;
+		if (receiveTime > 0)
+		{
+			mInputLatency.record(InputLatency::Queue, receiveTime, applyTime);
+			++numTimedInputs;
+		}
+	});
+	const float rotation = mInputStaging.takeRotation();
+	if (rotation != 0.f)
+	{
+		for (size_t i = 0; i < mPlayerStates.size(); i++)
+			mPlayerStates.setOrientation(i, mPlayerStates.mOrientations[i] + rotation);
+	}
+
+	if (mLastFrameTime < 0.0) //First update?
+	{
+		mLastFrameTime = time;
+		return;
+	}
+
+	//The same steps whatever the frame rate, so movement, collisions and spawns don't
+	//depend on how fast the slowest node draws
+	//A little slack keeps steps that are a rounding error short from slipping a frame
+	constexpr double slack = 1e-6;
+	mAccumulator += time - mLastFrameTime;
+	mLastFrameTime = time;
+	mLastSteps = 0;
+	while (mAccumulator + slack >= mStep && mLastSteps < mMaxSteps && !mIsEnded)
+	{
+		step(static_cast<float>(mStep));
+		mAccumulator = std::max(mAccumulator - mStep, 0.0);
+		++mLastSteps;
+	}
+
+	//Too far behind, drop the whole steps that are left instead of catching up later
+	if (mAccumulator + slack >= mStep)
+	{
+		const double dropped = mStep * std::floor((mAccumulator + slack) / mStep);
+		mAccumulator = std::max(mAccumulator - dropped, 0.0);
+		mDroppedTime += dropped;
+		if (!mIsEnded)
+			sgct::Log::Warning("Simulation fell behind, dropped %.1f ms (%.1f ms in total)",
+				dropped * 1000.0, mDroppedTime * 1000.0);
+	}
+#ifdef TRACY_ENABLE
+	TracyPlot("Simulation steps", static_cast<int64_t>(mLastSteps));
+#endif
+
+	mInputLatency.markSimulated(applyTime, InputLatency::now(), numTimedInputs);
+}
+
+void Simulation::step(float deltaTime)
+{
+	ZoneScoped;
+	//Kept for drawing between this step and the next, see beginRenderBlend
+	mPreviousPositions.resize(mPlayerStates.size());
+	mPreviousOrientations.resize(mPlayerStates.size());
+	for (size_t i = 0; i < mPlayerStates.size(); i++)
+	{
+		mPreviousPositions[i] = mPlayerStates.getPosition(i);
+		mPreviousOrientations[i] = mPlayerStates.mOrientations[i];
+	}
+
+	mSimulatedTime += deltaTime;
+	mTotalTime += deltaTime;
+	if (mTotalTime > mMaxTime)
+		end();
+
+	spawnCollectibles();
+
+	//Update players and collectibles, straight over the simulation arrays
+	//Chunks only touch their own slots, so they run on the job threads as they are
+	mJobs->parallelFor(mPlayerStates.size(), mPLAYERCHUNK, [this, deltaTime](size_t begin, size_t end) {
+		Integrator::advancePlayers(mPlayerStates, begin, end, deltaTime, mConstraint);
+	});
+
+	//Enabled collectibles are kept at the front of the pool, the rest are not simulated
+	mJobs->parallelFor(mNumCollectibles, mCOLLECTIBLECHUNK, [this, deltaTime](size_t begin, size_t end) {
+		Integrator::spinModels(mCollectibleStates, begin, end, deltaTime);
+	});
+
+	//TODO Update other type of objects
+
+	detectCollisions();
+}
+
+void Simulation::setThreads(unsigned numThreads)
+{
+	mJobs = std::make_unique<JobSystem>(numThreads);
+	sgct::Log::Info("Simulation runs on %u threads", mJobs->getNumThreads());
+}
+
+void Simulation::setTickRate(double rate, unsigned maxSteps)
+{
+	mStep = 1.0 / rate;
+	mMaxSteps = std::max(maxSteps, 1u);
+}
+
+void Simulation::beginRenderBlend()
+{
+	ZoneScoped;
+	if (mIsRenderBlended)
+		return;
+
+	//Players that joined after the last step are drawn where they are
+	const size_t numBlended = std::min(mPreviousPositions.size(), mPlayerStates.size());
+	const float alpha = getStepAlpha();
+	mSimulatedPositions.resize(numBlended);
+	mSimulatedOrientations.resize(numBlended);
+	for (size_t i = 0; i < numBlended; i++)
+	{
+		const glm::quat position = mPlayerStates.getPosition(i);
+		const float orientation = mPlayerStates.mOrientations[i];
+		mSimulatedPositions[i] = position;
+		mSimulatedOrientations[i] = orientation;
+
+		//Shortest way around, both for the quaternion and the angle
+		const glm::quat from = glm::dot(mPreviousPositions[i], position) < 0.f
+			? -mPreviousPositions[i] : mPreviousPositions[i];
+		mPlayerStates.setPosition(i, glm::normalize(glm::slerp(from, position, alpha)));
+		mPlayerStates.setOrientation(i, mPreviousOrientations[i]
+			+ alpha * std::remainder(orientation - mPreviousOrientations[i], glm::two_pi<float>()));
+	}
+	mIsRenderBlended = true;
+}
+
+void Simulation::endRenderBlend()
+{
+	if (!mIsRenderBlended)
+		return;
+
+	for (size_t i = 0; i < mSimulatedPositions.size(); i++)
+	{
+		mPlayerStates.setPosition(i, mSimulatedPositions[i]);
+		mPlayerStates.setOrientation(i, mSimulatedOrientations[i]);
+	}
+	mIsRenderBlended = false;
+}
+
+void Simulation::detectCollisions()
+{
+	ZoneScoped;
+	if (mPlayerStates.size() > 0 && mNumCollectibles > 0)
+	{
+		//Bucket enabled collectibles by direction so each player only tests nearby ones
+		mCollectibleDirections.resize(mNumCollectibles);
+		for (size_t j = 0; j < mNumCollectibles; j++)
+			mCollectibleDirections[j] = SphereGrid::directionFromQuat(mCollectibleStates.getPosition(j));
+		mCollectibleGrid.rebuild(mCollectibleDirections);
+
+		//Chunks of players are tested in parallel, each chunk lists its hits in player order
+		//The kernel compares the directions of the candidates in each range of the grid
+		//with the player's in batches, dot(a, b) >= cos(angle) is a true angular distance
+		const float cosAngle = std::cos(mPLAYERCOLLISIONANGLE + mCOLLECTIBLECOLLISIONANGLE);
+		const size_t numChunks = (mPlayerStates.size() + mCOLLISIONCHUNK - 1) / mCOLLISIONCHUNK;
+		if (mCollisionChunks.size() < numChunks)
+			mCollisionChunks.resize(numChunks);
+
+		mJobs->parallelFor(mPlayerStates.size(), mCOLLISIONCHUNK, [this, cosAngle](size_t begin, size_t end)
+		{
+			CollisionChunk& chunk = mCollisionChunks[begin / mCOLLISIONCHUNK];
+			chunk.mHits.clear();
+			//Sized for every slot, only grows with the capacity
+			chunk.mNear.resize(mCollectibleModels.size());
+			for (size_t i = begin; i < end; i++)
+			{
+				const glm::vec3 playerDirection = SphereGrid::directionFromQuat(mPlayerStates.getPosition(i));
+				mCollectibleGrid.forEachNearRange(playerDirection, [&](size_t first, size_t last)
+				{
+					const size_t numNear = Integrator::collectNear(playerDirection, cosAngle,
+						mCollectibleGrid.getX(), mCollectibleGrid.getY(), mCollectibleGrid.getZ(),
+						mCollectibleGrid.getItems(), first, last, chunk.mNear.data());
+					for (size_t n = 0; n < numNear; n++)
+						chunk.mHits.emplace_back(static_cast<uint32_t>(i), chunk.mNear[n]);
+				});
+			}
+		});
+
+		//Merged in player order whatever the number of threads, so points are the same as
+		//in a serial pass. Each collectible can only be picked up once, by the first player
+		//reaching it
+		mCollectedThisTick.assign(mNumCollectibles, false);
+		mCollectedHandles.clear();
+		for (size_t chunk = 0; chunk < numChunks; chunk++)
+		{
+			for (const std::pair<uint32_t, uint32_t>& hit : mCollisionChunks[chunk].mHits)
+			{
+				const size_t i = hit.first;
+				const size_t j = hit.second;
+				if (mCollectedThisTick[j])
+					continue;
+
+				mPlayers[i].mPoints += 10;
+				mIdPoints.push_back(std::make_pair(i, mPlayers[i].mPoints));
+				mCollectedThisTick[j] = true;
+				mCollectedHandles.push_back(mCollectibleHandles.handleAt(j));
+			}
+		}
+
+		//Handles follow the collectibles that are moved into the holes, so they can be
+		//disabled in any order
+		for (HandlePool::Handle handle : mCollectedHandles)
+			disableCollectible(handle);
+	}
+}
+
+void Simulation::spawnCollectibles()
+{
+	ZoneScoped;
+	//Each player's timer spawns one collectible, all players together spawn at a steady rate
+	const size_t spawned = mSpawnScheduler.update(mSimulatedTime, [this](uint32_t) {
+		enableCollectible(glm::quat(mPosGenerator.generatePos()));
+	});
+#ifdef TRACY_ENABLE
+	TracyPlot("Collectibles spawned", static_cast<int64_t>(spawned));
+#else
+	(void)spawned;
+#endif
+}
+
+void Simulation::start()
+{
+	mTotalTime = 0;
+	mIsStarted = true;
+}
+
+float Simulation::getPassedTime() const
+{
+	float var = mTotalTime / mMaxTime;
+	float value = (int)(var * 100 + .5);
+	return (float)value / 100;
+}
+
+bool Simulation::shouldSendTime()
+{
+	if (mTotalTime - mLastTime > 1) {
+		mLastTime = mTotalTime;
+		return true;
+	}
+	return false;
+}
+
+std::pair<glm::vec3, glm::vec3> Simulation::ColourSelector::getNextPair()
+{
+	//Step to the next primary colour once all secondary colours have been used with it
+	if (mSecondaryIt == mSecondaryColours.end())
+	{
+		mSecondaryIt = mSecondaryColours.begin();
+		++mPrimaryIt;
+	}
+
+	if (mPrimaryIt == mPrimaryColours.end())
+	{
+		mPrimaryIt = mPrimaryColours.begin();
+	}
+
+	return std::pair<glm::vec3, glm::vec3>(*mPrimaryIt, *mSecondaryIt++);
+}
+
+void Simulation::ColourSelector::shuffle(unsigned seed)
+{
+	std::default_random_engine rng;
+	rng.seed(seed);
+
+	std::shuffle(mPrimaryColours.begin(), mPrimaryColours.end(), rng);
+	std::shuffle(mSecondaryColours.begin(), mSecondaryColours.end(), rng);
+
+	reset();
+}
+
+void Simulation::ColourSelector::reset()
+{
+	mPrimaryIt = mPrimaryColours.begin();
+	mSecondaryIt = mSecondaryColours.begin();
+}
@@ -0,0 +1,325 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <random>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+#include "glm/glm.hpp"
+#include <glm/gtc/quaternion.hpp>
+#include "sgct/log.h"
+#include "sgct/profiling.h"
+
+#include "entitystore.hpp"
+#include "integrator.hpp"
+#include "spheregrid.hpp"
+#include "balljointconstraint.hpp"
+#include "inputstaging.hpp"
+#include "inputlatency.hpp"
+#include "jobsystem.hpp"
+#include "spawnscheduler.hpp"
+#include "handlepool.hpp"
+
+struct InputMessage;
+
+//Longest player name synchronised to the nodes
+constexpr unsigned NAMELIMIT = 20;
+
+//The game rules without anything to do with rendering: state of all players and
+//collectibles, movement, spawning, collision detection, points and the game clock
+//Game owns one and draws views on its state, the headless mode runs one on its own
+//Nothing in here needs a GL context or an SGCT window
+class Simulation
+{
+public:
+	//Encodes/decodes the simulated state for cluster synchronisation
+	friend class StateSync;
+
+	//Player data that is not advanced every tick
+	struct PlayerInfo
+	{
+		std::string mName;
+		std::pair<glm::vec3, glm::vec3> mColours;
+		int mPoints = 0;
+		bool mIsAlive = true;
+	};
+
+	//Allocate state for maxPlayers players and maxCollectibles collectibles, cycling
+	//through the trash models. Both grow by the same amount again when they run out, up
+	//to mMAXENTITIES, with a warning each time
+	//seed makes spawn positions and player colours repeatable, 0 picks a random seed
+	void init(size_t maxPlayers, size_t maxCollectibles, unsigned seed = 0);
+
+	//Add count collectible slots, fewer at mMAXENTITIES. Returns the number added
+	//Slots only ever get added, so views on existing slots stay valid
+	size_t growCollectibles(size_t count);
+
+	//Add a player and return its slot, players are never removed (only disabled)
+	size_t addPlayer(const std::string& name, const glm::quat& position, float orientation = 0.f,
+	                 float speed = mDEFAULTSPEED);
+
+	//Add a player at a random position, as players joining from their phones
+	size_t addPlayer(const std::string& name) { return addPlayer(name, glm::quat(mPosGenerator.generatePos())); }
+
+	//Add a player with known colours, used for roster data on nodes
+	size_t addPlayer(const std::string& name, const std::pair<glm::vec3, glm::vec3>& colours);
+
+	//Player input
+	void setTurnSpeed(size_t id, float turnSpeed) { mPlayerStates.mTurnSpeeds[id] = turnSpeed; }
+	//Keep the newest turn speed of player id until the next update, see InputStaging
+	void stageTurnSpeed(size_t id, float turnSpeed, uint32_t sequence, bool hasSequence,
+	                    int64_t receiveTime = 0)
+	{
+		mInputStaging.stageTurnSpeed(id, turnSpeed, sequence, hasSequence, receiveTime);
+	}
+	//Turn messages handled by the last update
+	const InputStaging::Counters& getInputCounters() const { return mInputStaging.getCounters(); }
+	//Delays of turn input on its way through the master, update records the Queue and
+	//Apply stages of inputs staged with a receive time
+	InputLatency& getInputLatency() { return mInputLatency; }
+	void setEnabled(size_t id, bool enabled) { mPlayerStates.mEnabled[id] = enabled ? 1 : 0; }
+
+	//Apply one decoded message from the server, as main.cpp does through Game. Used where
+	//a Simulation runs without a Game, by the headless master and DomedagenBench
+	void applyInput(const InputMessage& message, int64_t receiveTime);
+
+	//DEBUGGING TOOL: turn all players by deltaOrientation
+	//Staged like the turn input, so it is applied by the next update and not to a
+	//render blended state
+	void rotateAllPlayers(float deltaOrientation) { mInputStaging.stageRotation(deltaOrientation); }
+
+	//Enable the next free collectible at pos and return its handle, the handle is invalid
+	//if all are in use
+	HandlePool::Handle enableCollectible(const glm::quat& pos);
+	HandlePool::Handle enableCollectible() { return enableCollectible(glm::quat(mPosGenerator.generatePos())); }
+
+	//Disable a collectible by handle, false if it was disabled already
+	bool disableCollectible(HandlePool::Handle handle);
+
+	//Disable collectible index by moving the last enabled one into its place
+	//Enabled collectibles are always the first getNumCollectibles() slots
+	void disableCollectibleAndSwap(size_t index);
+
+	//Slot of a collectible while it is enabled, npos after it was disabled. Handles are only
+	//tracked on the master, nodes receive the slots from StateSync
+	size_t getCollectibleIndex(HandlePool::Handle handle) const { return mCollectibleHandles.indexOf(handle); }
+	HandlePool::Handle getCollectibleHandle(size_t index) const { return mCollectibleHandles.handleAt(index); }
+
+	//Advance the game to time (seconds on any monotonic clock) in fixed steps
+	//Time that is not a whole step yet is carried over to the next update
+	//The first call after start() only records the time
+	void update(double time);
+
+	//Step length 1 / rate seconds, at most maxSteps steps per update. Time beyond that is
+	//dropped, so a master that falls behind slows the game down instead of taking ever
+	//more steps per frame
+	void setTickRate(double rate, unsigned maxSteps);
+
+	//Collectibles each player spawns per second, spread evenly over the game
+	void setSpawnRate(float rate) { mSpawnScheduler.setRate(rate); }
+	//Time since the last step in seconds, and as a fraction of a step in [0, 1)
+	double getUnsteppedTime() const { return mAccumulator; }
+	float getStepAlpha() const { return static_cast<float>(mAccumulator / mStep); }
+	//Steps taken by the last update
+	unsigned getLastSteps() const { return mLastSteps; }
+
+	//Threads a step is split over, including the calling one. 0 uses every core, 1 (the
+	//default) runs everything on the calling thread. The result is the same either way
+	void setThreads(unsigned numThreads);
+	const JobSystem& getJobs() const { return *mJobs; }
+
+	//Draw players getStepAlpha() of the way between the last two steps instead of at the
+	//last step, so movement stays smooth when steps and frames don't line up
+	//The blended state replaces the simulated one until endRenderBlend(), which has to
+	//be called before the next update or encode
+	void beginRenderBlend();
+	void endRenderBlend();
+
+	//Game clock
+	void start();
+	void end() { mIsEnded = true; }
+	bool isStarted() const { return mIsStarted; }
+	bool isEnded() const { return mIsEnded; }
+	void setMaxTime(float time) { mMaxTime = time; }
+
+	//Fraction of the game time passed, rounded to two decimals
+	float getPassedTime() const;
+
+	//True once per second of game time, for updating the timer on the phones
+	bool shouldSendTime();
+
+	//Points of players that scored since the last call, as (id, total points)
+	//The caller consumes them and clears the vector
+	std::vector<std::pair<unsigned, int>>& getPointEvents() { return mIdPoints; }
+
+	//Accessors
+	size_t getNumPlayers() const { return mPlayers.size(); }
+	const PlayerInfo& getPlayer(size_t id) const { return mPlayers[id]; }
+	bool isEnabled(size_t id) const { return mPlayerStates.mEnabled[id] != 0; }
+	size_t getNumCollectibles() const { return mNumCollectibles; }
+	//Current capacities, they grow when exceeded
+	size_t getMaxPlayers() const { return mPlayerCapacity; }
+	size_t getMaxCollectibles() const { return mCollectibleModels.size(); }
+	int getCollectibleModel(size_t i) const { return mCollectibleModels[i]; }
+
+	//Simulated state, slot i of a store belongs to player/collectible i
+	EntityStore& getPlayerStates() { return mPlayerStates; }
+	const EntityStore& getPlayerStates() const { return mPlayerStates; }
+	EntityStore& getCollectibleStates() { return mCollectibleStates; }
+	const EntityStore& getCollectibleStates() const { return mCollectibleStates; }
+
+	//Keeps players inside the visible area, the same for all players
+	static void setConstraints(float fov, float tilt) { mConstraint = BallJointConstraint{ fov, tilt }; }
+	static const BallJointConstraint& getConstraint() { return mConstraint; }
+
+	//Most players and collectibles the u16 counts and ids of StateSync and the phone
+	//messages can address
+	static constexpr size_t mMAXENTITIES = UINT16_MAX;
+
+	//Default simulated state of new players
+	static constexpr float mDEFAULTSPEED = 0.2f;
+	static constexpr float mDEFAULTTURNSPEED = 0.2f;
+
+	//Size of players and collectibles as an angle on the dome (radians). A player touches
+	//a collectible when their directions from the centre are less than the sum apart
+	static constexpr float mPLAYERCOLLISIONANGLE = 0.06f;
+	static constexpr float mCOLLECTIBLECOLLISIONANGLE = 0.05f;
+
+private:
+	EntityStore mPlayerStates;
+	std::vector<PlayerInfo> mPlayers;
+	//Room for this many players, grows by mPlayerChunk
+	size_t mPlayerCapacity = 0;
+	size_t mPlayerChunk = 1;
+
+	//Enabled collectibles are kept in [0, mNumCollectibles), so the next free one is
+	//always mNumCollectibles. mCollectibleModels[i] is the model slot of collectible i
+	EntityStore mCollectibleStates;
+	std::vector<uint8_t> mCollectibleModels;
+	size_t mNumCollectibles = 0;
+	//New slots are added mCollectibleChunk at a time, cycling through mTrashModels
+	size_t mCollectibleChunk = 1;
+	std::vector<uint8_t> mTrashModels;
+	bool mIsCollectibleSaturated = false;
+	//Which handle is in which of the enabled slots, moved along with the slots
+	HandlePool mCollectibleHandles;
+	SpawnScheduler mSpawnScheduler;
+
+	//Turn input received since the last update
+	InputStaging mInputStaging;
+	InputLatency mInputLatency;
+
+	//Container to store player id and new points
+	//Data sent to server to update score on each player's phone
+	std::vector<std::pair<unsigned, int>> mIdPoints;
+
+	//Game clock (seconds)
+	double mLastFrameTime = -1.0;
+	//Fixed step, simulated time not stepped yet and time simulated since the first update
+	double mStep = 1.0 / 60.0;
+	unsigned mMaxSteps = 4;
+	double mAccumulator = 0.0;
+	double mSimulatedTime = 0.0;
+	unsigned mLastSteps = 0;
+	double mDroppedTime = 0.0;
+	float mTotalTime = 0.f, mMaxTime = 60.f;
+	float mLastTime = 0.f;
+	bool mIsStarted = false;
+	bool mIsEnded = false;
+
+	//Spatial index over enabled collectibles, rebuilt every detectCollisions()
+	SphereGrid mCollectibleGrid{ mPLAYERCOLLISIONANGLE + mCOLLECTIBLECOLLISIONANGLE };
+
+	//Scratch buffers for detectCollisions(), kept to avoid reallocating every tick
+	//Chunk c of players puts its (player, collectible) hits in mCollisionChunks[c].mHits,
+	//mNear is the output of the collision kernel for one range of the grid
+	struct CollisionChunk
+	{
+		std::vector<std::pair<uint32_t, uint32_t>> mHits;
+		std::vector<uint32_t> mNear;
+	};
+	std::vector<glm::vec3> mCollectibleDirections;
+	std::vector<CollisionChunk> mCollisionChunks;
+	std::vector<bool> mCollectedThisTick;
+	std::vector<HandlePool::Handle> mCollectedHandles;
+
+	static BallJointConstraint mConstraint;
+
+	//Runs the parallel parts of a step, chunk sizes keep whole SIMD batches together
+	std::unique_ptr<JobSystem> mJobs = std::make_unique<JobSystem>(1);
+	static constexpr size_t mPLAYERCHUNK = 16;
+	static constexpr size_t mCOLLECTIBLECHUNK = 64;
+	static constexpr size_t mCOLLISIONCHUNK = 8;
+
+	//Player positions and orientations before the last step, and the simulated ones while
+	//the blended state is drawn
+	std::vector<glm::quat> mPreviousPositions, mSimulatedPositions;
+	std::vector<float> mPreviousOrientations, mSimulatedOrientations;
+	bool mIsRenderBlended = false;
+
+	//Make room for capacity players in all per player arrays
+	void reservePlayers(size_t capacity);
+
+	//Advance everything by one fixed step
+	void step(float deltaTime);
+
+	//Collision detection between players and enabled collectibles
+	void detectCollisions();
+
+	//Spawn the collectibles that are due at the simulated time, see SpawnScheduler
+	void spawnCollectibles();
+
+	struct PositionGenerator
+	{
+		void init(unsigned seed)
+		{
+			gen = std::mt19937(seed);
+			rng = std::uniform_real_distribution<>(-1.5f, 1.5f);
+		}
+
+		//RNG stuff
+		std::mt19937 gen;
+		std::uniform_real_distribution<> rng;
+
+		glm::vec3 generatePos()
+		{
+			ZoneScoped;
+			return glm::vec3(1.5f + rng(gen), rng(gen), 0.f);
+		}
+
+	} mPosGenerator;
+
+	struct ColourSelector
+	{
+		std::vector<glm::vec3> mPrimaryColours{
+			{0.2f, 0.2f, 0.2f},		// Dark gray
+			{0.3f, 0.3f, 0.5f},		// Navy blue
+			{0.8f, 0.9f, 0.9f},		// Pale sky blue
+			{0.1f, 0.3f, 0.3f},		// Dark green
+			{0.5f, 0.2f, 0.2f},		// Brown
+			{0.9f, 0.9f, 0.8f},		// Beige
+			{0.3f, 0.2f, 0.3f},		// Mauve
+			{0.4f, 0.1f, 0.2f},		// Wine red
+		};
+		std::vector<glm::vec3> mSecondaryColours{
+			{1.f, 0.2f, 0.2f},		// Red
+			{1.f, 0.4f, 0.8f},		// Pink
+			{0.4f, 0.8f, 1.f},		// Cyan
+			{1.f, 1.f, 0.1f},		// Yellow
+			{0.4f, 1.f, 0.2f},		// Green
+			{1.f, 0.7f, 0.2f},		// Orange
+			{0.8f, 0.6f, 1.f},		// Lavender
+			{0.8f, 0.8f, 0.8f}		// Silver
+		};
+
+		std::vector<glm::vec3>::iterator mPrimaryIt;
+		std::vector<glm::vec3>::iterator mSecondaryIt;
+
+		std::pair<glm::vec3, glm::vec3> getNextPair();
+		void shuffle(unsigned seed);
+		void reset();
+	} mColourSelector;
+};
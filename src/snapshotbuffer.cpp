@@ -0,0 +1,68 @@
+#include "snapshotbuffer.hpp"
+
+#include <algorithm>
+
+SnapshotBuffer::Snapshot& SnapshotBuffer::beginSnapshot(double time)
+{
+	Snapshot& next = mSnapshots[nextSlot()];
+	if (mCount > 0)
+	{
+		//assign() reuses the capacity of the slot being overwritten
+		const Snapshot& newest = mSnapshots[mNewest];
+		next.mPlayerPositions.assign(newest.mPlayerPositions.begin(), newest.mPlayerPositions.end());
+		next.mPlayerOrientations.assign(newest.mPlayerOrientations.begin(), newest.mPlayerOrientations.end());
+		next.mCollectiblePositions.assign(newest.mCollectiblePositions.begin(), newest.mCollectiblePositions.end());
+		next.mCollectibleRotations.assign(newest.mCollectibleRotations.begin(), newest.mCollectibleRotations.end());
+		next.mCollectibleModels.assign(newest.mCollectibleModels.begin(), newest.mCollectibleModels.end());
+		next.mNumCollectibles = newest.mNumCollectibles;
+	}
+	next.mTime = time;
+	return next;
+}
+
+void SnapshotBuffer::commitSnapshot()
+{
+	mNewest = nextSlot();
+	mCount = std::min(mCount + 1, mCAPACITY);
+}
+
+const SnapshotBuffer::Snapshot& SnapshotBuffer::fromNewest(size_t age) const
+{
+	return mSnapshots[(mNewest + mSnapshots.size() - age) % mSnapshots.size()];
+}
+
+void SnapshotBuffer::bracket(double time, double maxExtrapolation,
+                             const Snapshot*& from, const Snapshot*& to, float& t) const
+{
+	from = to = &newest();
+	t = 0.f;
+	if (mCount < 2)
+		return;
+
+	//Past the newest snapshot, continue along the last two
+	if (time >= to->mTime)
+	{
+		from = &fromNewest(1);
+		time = std::min(time, to->mTime + maxExtrapolation);
+	}
+	else
+	{
+		//Find the newest snapshot that is not after time
+		size_t age = 1;
+		while (age < mCount && fromNewest(age).mTime > time)
+			age++;
+
+		//Older than everything we have, show the oldest state
+		if (age == mCount)
+		{
+			from = to = &fromNewest(mCount - 1);
+			return;
+		}
+
+		from = &fromNewest(age);
+		to = &fromNewest(age - 1);
+	}
+
+	const double span = to->mTime - from->mTime;
+	t = span > 0.0 ? static_cast<float>((time - from->mTime) / span) : 1.f;
+}
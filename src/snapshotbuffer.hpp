@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/gtc/quaternion.hpp>
+
+//The last few game states received from master, used on nodes to render in between
+//(and shortly past) synchronised states
+//Snapshots are reused in a ring, their vectors keep their capacity between frames
+class SnapshotBuffer
+{
+public:
+	//Synced state at one point in master time
+	struct Snapshot
+	{
+		double mTime = 0.0;
+
+		std::vector<glm::quat> mPlayerPositions;
+		std::vector<float> mPlayerOrientations;
+
+		//Slots past mNumCollectibles hold the last values sent for them
+		std::vector<glm::quat> mCollectiblePositions;
+		std::vector<glm::quat> mCollectibleRotations;
+		std::vector<uint8_t> mCollectibleModels;
+		size_t mNumCollectibles = 0;
+	};
+
+	//Number of snapshots kept for interpolation
+	static constexpr size_t mCAPACITY = 4;
+
+	//Start the next snapshot as a copy of the newest one, deltas are applied on top of it
+	//Not visible to bracket() until commitSnapshot()
+	Snapshot& beginSnapshot(double time);
+
+	//Make the snapshot from beginSnapshot() the newest one, dropping the oldest if full
+	void commitSnapshot();
+
+	bool empty() const { return mCount == 0; }
+	const Snapshot& newest() const { return mSnapshots[mNewest]; }
+
+	//Find the two snapshots to blend for time, with from <= to in time
+	//t in [0, 1] interpolates between them, t > 1 extrapolates past the newest snapshot
+	//by at most maxExtrapolation seconds. from == to if there is nothing to blend
+	void bracket(double time, double maxExtrapolation,
+	             const Snapshot*& from, const Snapshot*& to, float& t) const;
+
+private:
+	//mCAPACITY live snapshots plus the one being filled in
+	std::array<Snapshot, mCAPACITY + 1> mSnapshots;
+	size_t mNewest = 0;
+	size_t mCount = 0;
+
+	//Snapshot age steps back from the newest one
+	const Snapshot& fromNewest(size_t age) const;
+	size_t nextSlot() const { return (mNewest + 1) % mSnapshots.size(); }
+};
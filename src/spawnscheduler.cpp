@@ -0,0 +1,22 @@
+#include "spawnscheduler.hpp"
+
+#include <cmath>
+
+void SpawnScheduler::setRate(float rate)
+{
+	mRate = rate;
+	if (rate > 0.f)
+		mInterval = 1.0 / rate;
+}
+
+void SpawnScheduler::addSource(double now)
+{
+	//Golden ratio steps spread any number of players evenly over the interval, and
+	//players joining later fill the largest gaps
+	constexpr double goldenRatio = 0.6180339887498949;
+	double offset = mNumSources * goldenRatio;
+	offset -= std::floor(offset);
+
+	mEvents.push(Event{ now + offset * mInterval, mNumSources });
+	++mNumSources;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <queue>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+//Spawn timers of all players in a min-heap on game time
+//Every player spawns a collectible each 1 / rate seconds. The first spawn of each player
+//is offset by a different fraction of the interval, so spawns are spread evenly over the
+//interval instead of all landing in the same step
+class SpawnScheduler
+{
+public:
+	//Collectibles per second and player, 0 or less spawns nothing
+	void setRate(float rate);
+	float getRate() const { return mRate; }
+
+	//Add the timer of the next player, joining at game time now
+	void addSource(double now);
+
+	//Call spawn(source) for every timer that is due at game time now, in time order,
+	//and schedule its next spawn. Timers that are more than one interval late (spawning
+	//was paused with rate 0) start over instead of spawning a burst to catch up
+	template<typename Fn>
+	size_t update(double now, Fn&& spawn);
+
+	size_t getNumSources() const { return mNumSources; }
+
+private:
+	struct Event
+	{
+		double mTime;
+		uint32_t mSource;
+
+		//Earliest first in std::priority_queue, ties by source so runs are repeatable
+		bool operator>(const Event& other) const
+		{
+			return mTime > other.mTime || (mTime == other.mTime && mSource > other.mSource);
+		}
+	};
+
+	std::priority_queue<Event, std::vector<Event>, std::greater<Event>> mEvents;
+	float mRate = 0.25f;
+	double mInterval = 4.0;
+	uint32_t mNumSources = 0;
+};
+
+template<typename Fn>
+size_t SpawnScheduler::update(double now, Fn&& spawn)
+{
+	if (mRate <= 0.f)
+		return 0;
+
+	size_t spawned = 0;
+	while (!mEvents.empty() && mEvents.top().mTime <= now)
+	{
+		Event event = mEvents.top();
+		mEvents.pop();
+		spawn(event.mSource);
+		++spawned;
+
+		event.mTime += mInterval;
+		if (event.mTime <= now - mInterval)
+			event.mTime = now + mInterval;
+		mEvents.push(event);
+	}
+	return spawned;
+}
@@ -0,0 +1,68 @@
+#include "spheregrid.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+SphereGrid::SphereGrid(float maxQueryAngle)
+{
+	//Two directions within maxQueryAngle are at most this far apart (chord length),
+	//so with cells at least this large they always end up in neighbouring cells
+	mCellSize = std::max(2.f * std::sin(maxQueryAngle / 2.f), 1e-3f);
+	mDim = static_cast<int>(std::ceil(2.f / mCellSize)) + 1;
+
+	mCellStart.resize(static_cast<size_t>(mDim) * mDim * mDim + 1, 0);
+}
+
+int SphereGrid::cellCoord(float c) const
+{
+	int coord = static_cast<int>((c + 1.f) / mCellSize);
+	return std::clamp(coord, 0, mDim - 1);
+}
+
+void SphereGrid::reserve(size_t count)
+{
+	mItems.reserve(count);
+	mItemCells.reserve(count);
+	mX.reserve(count);
+	mY.reserve(count);
+	mZ.reserve(count);
+}
+
+void SphereGrid::rebuild(const std::vector<glm::vec3>& directions)
+{
+	ZoneScoped;
+	const size_t numCells = mCellStart.size() - 1;
+
+	mItems.resize(directions.size());
+	mItemCells.resize(directions.size());
+	mX.resize(directions.size());
+	mY.resize(directions.size());
+	mZ.resize(directions.size());
+	std::fill(mCellStart.begin(), mCellStart.end(), 0);
+
+	//Count items per cell, offset by one so the prefix sum gives start indices
+	for (size_t i = 0; i < directions.size(); i++)
+	{
+		const glm::vec3& d = directions[i];
+		const uint32_t cell = static_cast<uint32_t>(cellIndex(cellCoord(d.x), cellCoord(d.y), cellCoord(d.z)));
+		mItemCells[i] = cell;
+		++mCellStart[cell + 1];
+	}
+
+	for (size_t c = 0; c < numCells; c++)
+		mCellStart[c + 1] += mCellStart[c];
+
+	//Scatter, using the end of each range as a running cursor that is restored afterwards
+	for (size_t i = 0; i < directions.size(); i++)
+	{
+		const uint32_t pos = mCellStart[mItemCells[i]]++;
+		mItems[pos] = static_cast<uint32_t>(i);
+		mX[pos] = directions[i].x;
+		mY[pos] = directions[i].y;
+		mZ[pos] = directions[i].z;
+	}
+
+	for (size_t c = numCells; c > 0; c--)
+		mCellStart[c] = mCellStart[c - 1];
+	mCellStart[0] = 0;
+}
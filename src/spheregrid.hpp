@@ -0,0 +1,116 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+#include "sgct/profiling.h"
+
+//Spatial index for objects on the surface of the dome sphere
+//Objects are bucketed by their unit direction vector in a uniform grid over [-1, 1]^3,
+//which avoids the seams a cube map or lat-long grid would have at face/pole borders.
+//The cell size is chosen from the largest angle that will ever be queried, so a query
+//only has to visit the 3x3x3 block of cells around the query direction.
+class SphereGrid
+{
+public:
+	//maxQueryAngle is the largest angular distance (radians) used in forEachNear()
+	SphereGrid(float maxQueryAngle);
+
+	//Bucket all directions, O(n) counting sort. Previous content is discarded
+	//Indices passed to forEachNear callbacks are indices into directions
+	void rebuild(const std::vector<glm::vec3>& directions);
+
+	//Make room for count directions, so rebuilds with up to that many don't allocate
+	void reserve(size_t count);
+
+	//Call fn(index) for every stored direction that might be within maxQueryAngle of
+	//direction. Candidates are conservative, the caller does the exact test
+	template<typename Fn>
+	void forEachNear(const glm::vec3& direction, Fn&& fn) const;
+
+	//Same candidates as forEachNear, as fn(begin, end) ranges of positions in getItems()
+	//and the direction arrays. Neighbouring cells along x are one range, so a query
+	//visits at most 9 ranges that batch kernels can run over directly
+	template<typename Fn>
+	void forEachNearRange(const glm::vec3& direction, Fn&& fn) const;
+
+	//Items sorted by cell and their directions in the same order, from the last rebuild
+	const uint32_t* getItems() const { return mItems.data(); }
+	const float* getX() const { return mX.data(); }
+	const float* getY() const { return mY.data(); }
+	const float* getZ() const { return mZ.data(); }
+
+	size_t size() const { return mItems.size(); }
+
+	//Direction an object at position q is facing the origin from,
+	//same convention as the transformation in GameObject
+	static glm::vec3 directionFromQuat(const glm::quat& q) { return q * glm::vec3(0.f, 0.f, -1.f); }
+
+private:
+	//Cell coordinate along one axis for a direction component in [-1, 1]
+	int cellCoord(float c) const;
+	size_t cellIndex(int x, int y, int z) const { return (static_cast<size_t>(z) * mDim + y) * mDim + x; }
+
+	//Side length of a cell and number of cells per axis
+	float mCellSize;
+	int mDim;
+
+	//mCellStart[c] to mCellStart[c + 1] is the range in mItems belonging to cell c
+	std::vector<uint32_t> mCellStart;
+	std::vector<uint32_t> mItems;
+
+	//Cell of each item from the last rebuild, kept to avoid recomputing it in the scatter
+	std::vector<uint32_t> mItemCells;
+
+	//Direction of mItems[i], structure of arrays
+	std::vector<float> mX, mY, mZ;
+};
+
+template<typename Fn>
+void SphereGrid::forEachNear(const glm::vec3& direction, Fn&& fn) const
+{
+	if (mItems.empty())
+		return;
+
+	const int cx = cellCoord(direction.x);
+	const int cy = cellCoord(direction.y);
+	const int cz = cellCoord(direction.z);
+
+	for (int z = std::max(cz - 1, 0); z <= std::min(cz + 1, mDim - 1); z++)
+	{
+		for (int y = std::max(cy - 1, 0); y <= std::min(cy + 1, mDim - 1); y++)
+		{
+			for (int x = std::max(cx - 1, 0); x <= std::min(cx + 1, mDim - 1); x++)
+			{
+				const size_t cell = cellIndex(x, y, z);
+				for (uint32_t i = mCellStart[cell]; i < mCellStart[cell + 1]; i++)
+					fn(static_cast<size_t>(mItems[i]));
+			}
+		}
+	}
+}
+
+template<typename Fn>
+void SphereGrid::forEachNearRange(const glm::vec3& direction, Fn&& fn) const
+{
+	if (mItems.empty())
+		return;
+
+	const int cx = cellCoord(direction.x);
+	const int cy = cellCoord(direction.y);
+	const int cz = cellCoord(direction.z);
+
+	for (int z = std::max(cz - 1, 0); z <= std::min(cz + 1, mDim - 1); z++)
+	{
+		for (int y = std::max(cy - 1, 0); y <= std::min(cy + 1, mDim - 1); y++)
+		{
+			const uint32_t begin = mCellStart[cellIndex(std::max(cx - 1, 0), y, z)];
+			const uint32_t end = mCellStart[cellIndex(std::min(cx + 1, mDim - 1), y, z) + 1];
+			if (begin < end)
+				fn(static_cast<size_t>(begin), static_cast<size_t>(end));
+		}
+	}
+}
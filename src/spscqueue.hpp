@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <cstddef>
+
+//Lock-free queue between exactly one producer thread and one consumer thread
+//The slots are allocated once and reused, so slot contents such as vectors keep their
+//capacity and the queue stops allocating once it has warmed up
+//Producer: back() to get a free slot, fill it, push(). Consumer: front(), read, pop()
+template<typename T>
+class SpscQueue
+{
+public:
+	explicit SpscQueue(size_t capacity)
+		: mSlots(roundUpToPowerOfTwo(capacity)), mMask{ mSlots.size() - 1 }
+	{
+	}
+
+	//Free slot to fill before push, nullptr if the queue is full
+	T* back()
+	{
+		const size_t tail = mTail.load(std::memory_order_relaxed);
+		if (tail - mHead.load(std::memory_order_acquire) == mSlots.size())
+			return nullptr;
+		return &mSlots[tail & mMask];
+	}
+
+	void push()
+	{
+		mTail.store(mTail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	//Oldest filled slot, nullptr if the queue is empty
+	T* front()
+	{
+		const size_t head = mHead.load(std::memory_order_relaxed);
+		if (head == mTail.load(std::memory_order_acquire))
+			return nullptr;
+		return &mSlots[head & mMask];
+	}
+
+	void pop()
+	{
+		mHead.store(mHead.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	bool empty() const
+	{
+		return mHead.load(std::memory_order_acquire) == mTail.load(std::memory_order_acquire);
+	}
+
+	//Only exact when called from the producer or the consumer while the other is idle
+	size_t size() const
+	{
+		return mTail.load(std::memory_order_acquire) - mHead.load(std::memory_order_acquire);
+	}
+
+	size_t capacity() const { return mSlots.size(); }
+
+private:
+	static size_t roundUpToPowerOfTwo(size_t n)
+	{
+		size_t power = 1;
+		while (power < n)
+			power *= 2;
+		return power;
+	}
+
+	std::vector<T> mSlots;
+	const size_t mMask;
+
+	//Written by the consumer and the producer respectively, kept on separate cache lines
+	alignas(64) std::atomic<size_t> mHead{ 0 };
+	alignas(64) std::atomic<size_t> mTail{ 0 };
+};
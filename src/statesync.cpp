@@ -0,0 +1,605 @@
+#include "statesync.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+#include "glm/gtc/constants.hpp"
+#include "sgct/log.h"
+#include "sgct/profiling.h"
+
+#include "simulation.hpp"
+
+namespace
+{
+	//Size of one element of the SyncableData vector the nodes used to receive
+	//(PlayerData 64 + PositionData 44 + CollectibleData 4 + bool, padded to 4)
+	//plus the size prefix, used to report how many bytes the old protocol would have sent
+	constexpr uint64_t LEGACYELEMENTSIZE = 116;
+	constexpr uint64_t LEGACYVECTORSIZE = 8;
+
+	constexpr uint8_t ALLPLAYERFIELDS = 0x0F;
+	constexpr uint8_t ALLCOLLECTIBLEFIELDS = 0x07;
+
+	constexpr uint32_t QUATMAX = (1u << StateSync::mQUATBITS) - 1;
+	constexpr uint64_t QUATMASK = QUATMAX;
+
+	//Changed bitmaps are written in one go once all entities have been compared
+	void setBit(std::vector<std::byte>& out, size_t bitmapStart, size_t i)
+	{
+		out[bitmapStart + i / 8] |= std::byte(1 << (i % 8));
+	}
+
+	bool getBit(const std::vector<std::byte>& data, size_t bitmapStart, size_t i)
+	{
+		return (std::to_integer<uint8_t>(data[bitmapStart + i / 8]) >> (i % 8)) & 1;
+	}
+
+	//Slerp element i of from towards to, falls back to to if the element is new or jumped
+	glm::quat blendQuat(const std::vector<glm::quat>& from, const std::vector<glm::quat>& to,
+	                    size_t i, float t)
+	{
+		if (i >= from.size())
+			return to[i];
+
+		const float cosHalfAngle = std::abs(glm::dot(from[i], to[i]));
+		if (cosHalfAngle < std::cos(StateSync::mSNAPANGLE * 0.5f))
+			return to[i];
+
+		return glm::normalize(glm::slerp(from[i], to[i], t));
+	}
+
+	//Blend angles along the shorter way around the circle
+	float blendAngle(float from, float to, float t)
+	{
+		float delta = std::remainder(to - from, glm::two_pi<float>());
+		return from + delta * t;
+	}
+
+	//Weight of each new clock offset sample on nodes
+	constexpr double CLOCKSMOOTHING = 0.1;
+}
+
+uint64_t StateSync::packQuat(const glm::quat& q)
+{
+	const float c[4] = { q.w, q.x, q.y, q.z };
+
+	//The largest component is left out and rebuilt from the others on the nodes
+	unsigned largest = 0;
+	for (unsigned i = 1; i < 4; i++)
+	{
+		if (std::abs(c[i]) > std::abs(c[largest]))
+			largest = i;
+	}
+
+	//q and -q are the same rotation, flip so the dropped component is positive
+	const float sign = c[largest] < 0.f ? -1.f : 1.f;
+
+	//The remaining components are in [-1/sqrt(2), 1/sqrt(2)]
+	uint64_t bits = static_cast<uint64_t>(largest) << (3 * mQUATBITS);
+	unsigned shift = 2 * mQUATBITS;
+	for (unsigned i = 0; i < 4; i++)
+	{
+		if (i == largest)
+			continue;
+
+		const float normalized = (sign * c[i] * glm::root_two<float>() + 1.f) * 0.5f;
+		const float clamped = std::clamp(normalized, 0.f, 1.f);
+		bits |= static_cast<uint64_t>(std::lround(clamped * QUATMAX)) << shift;
+		shift -= mQUATBITS;
+	}
+
+	return bits;
+}
+
+glm::quat StateSync::unpackQuat(uint64_t bits)
+{
+	const unsigned largest = static_cast<unsigned>(bits >> (3 * mQUATBITS)) & 3;
+
+	float c[4];
+	float sumSquares = 0.f;
+	unsigned shift = 2 * mQUATBITS;
+	for (unsigned i = 0; i < 4; i++)
+	{
+		if (i == largest)
+			continue;
+
+		const float normalized = static_cast<float>((bits >> shift) & QUATMASK) / QUATMAX;
+		c[i] = (normalized * 2.f - 1.f) / glm::root_two<float>();
+		sumSquares += c[i] * c[i];
+		shift -= mQUATBITS;
+	}
+	c[largest] = std::sqrt(std::max(0.f, 1.f - sumSquares));
+
+	return glm::normalize(glm::quat(c[0], c[1], c[2], c[3]));
+}
+
+uint16_t StateSync::packAngle(float angle)
+{
+	//Orientation accumulates freely on master, only the angle modulo 2pi matters
+	const float turns = angle / glm::two_pi<float>();
+	const float fraction = turns - std::floor(turns);
+	return static_cast<uint16_t>(std::lround(fraction * 65536.f) & 0xFFFF);
+}
+
+float StateSync::unpackAngle(uint16_t bits)
+{
+	return static_cast<float>(bits) / 65536.f * glm::two_pi<float>();
+}
+
+uint8_t StateSync::packColour(float c)
+{
+	return static_cast<uint8_t>(std::lround(std::clamp(c, 0.f, 1.f) * 255.f));
+}
+
+float StateSync::unpackColour(uint8_t c)
+{
+	return static_cast<float>(c) / 255.f;
+}
+
+void StateSync::writeQuat(std::vector<std::byte>& out, uint64_t bits)
+{
+	for (unsigned i = 0; i < 6; i++)
+		out.push_back(std::byte((bits >> (8 * i)) & 0xFF));
+}
+
+bool StateSync::readQuat(const std::vector<std::byte>& data, unsigned int& pos, uint64_t& bits)
+{
+	if (pos + 6 > data.size())
+		return false;
+
+	bits = 0;
+	for (unsigned i = 0; i < 6; i++)
+		bits |= static_cast<uint64_t>(std::to_integer<uint8_t>(data[pos + i])) << (8 * i);
+	pos += 6;
+	return true;
+}
+
+void StateSync::setRate(float rate)
+{
+	mInterval = rate > 0.f ? 1.0 / rate : 0.0;
+}
+
+void StateSync::setInterpolation(bool enabled, double maxExtrapolation)
+{
+	mInterpolate = enabled;
+	mMaxExtrapolation = maxExtrapolation;
+}
+
+size_t StateSync::maxMessageSize(size_t numPlayers, size_t numCollectibles)
+{
+	constexpr size_t header = 2 * sizeof(uint8_t) + sizeof(uint32_t) + sizeof(double) + 2 * sizeof(uint16_t);
+	constexpr size_t rosterHeader = 2 * sizeof(uint16_t);
+	constexpr size_t rosterEntry = 1 + NAMELIMIT + 6;
+	constexpr size_t player = 1 + 6 + sizeof(uint16_t) + sizeof(int32_t) + 1;
+	constexpr size_t collectible = 1 + 6 + 6 + 1;
+
+	return header + rosterHeader
+		+ numPlayers * (rosterEntry + player) + (numPlayers + 7) / 8
+		+ numCollectibles * collectible + (numCollectibles + 7) / 8;
+}
+
+size_t StateSync::maxMessageSize(const Simulation& simulation)
+{
+	return maxMessageSize(simulation.mPlayers.size(), simulation.mNumCollectibles);
+}
+
+void StateSync::encode(const Simulation& simulation, std::vector<std::byte>& output, double time)
+{
+	ZoneScoped;
+	const size_t numPlayers = std::min<size_t>(simulation.mPlayers.size(), UINT16_MAX);
+	const size_t numCollectibles = std::min<size_t>(simulation.mNumCollectibles, UINT16_MAX);
+
+	//The old protocol sent everything every frame
+	mLegacyBytes += LEGACYVECTORSIZE + (numPlayers + numCollectibles) * LEGACYELEMENTSIZE;
+	++mEncodeCalls;
+
+	if (time < mNextEncodeTime)
+		return;
+	mNextEncodeTime = std::max(mNextEncodeTime + mInterval, time);
+
+	//Room for every slot, so players joining and collectibles spawning within the
+	//capacities don't allocate
+	mSentPlayers.reserve(simulation.getMaxPlayers());
+	mSentCollectibles.reserve(simulation.getMaxCollectibles());
+
+	const size_t messageStart = output.size();
+	output.reserve(messageStart + maxMessageSize(simulation));
+
+	const EntityStore& playerStates = simulation.mPlayerStates;
+	const EntityStore& collectibleStates = simulation.mCollectibleStates;
+
+	const bool isKeyframe = mFrame % mKEYFRAMEINTERVAL == 0;
+	const bool hasRoster = isKeyframe || numPlayers > mRosterSize;
+
+	//Header
+	uint8_t flags = 0;
+	if (isKeyframe)
+		flags |= FLAG_KEYFRAME;
+	if (hasRoster)
+		flags |= FLAG_ROSTER;
+	write(output, mVERSION);
+	write(output, flags);
+	write(output, mFrame);
+	write(output, time);
+	write(output, static_cast<uint16_t>(numPlayers));
+	write(output, static_cast<uint16_t>(numCollectibles));
+
+	//Roster, everything on keyframes so nodes can recover, otherwise only new players
+	if (hasRoster)
+	{
+		const size_t first = isKeyframe ? 0 : mRosterSize;
+		write(output, static_cast<uint16_t>(first));
+		write(output, static_cast<uint16_t>(numPlayers - first));
+		for (size_t i = first; i < numPlayers; i++)
+		{
+			const Simulation::PlayerInfo& player = simulation.mPlayers[i];
+			const std::string& name = player.mName;
+			const size_t nameLength = std::min<size_t>(name.length(), NAMELIMIT);
+			write(output, static_cast<uint8_t>(nameLength));
+			for (size_t c = 0; c < nameLength; c++)
+				output.push_back(std::byte(name[c]));
+
+			const auto& colours = player.mColours;
+			for (const glm::vec3& colour : { colours.first, colours.second })
+			{
+				write(output, packColour(colour.r));
+				write(output, packColour(colour.g));
+				write(output, packColour(colour.b));
+			}
+		}
+		mRosterSize = numPlayers;
+	}
+
+	//Players
+	size_t bitmapStart = output.size();
+	output.resize(bitmapStart + (numPlayers + 7) / 8, std::byte(0));
+	for (size_t i = 0; i < numPlayers; i++)
+	{
+		const Simulation::PlayerInfo& player = simulation.mPlayers[i];
+		SentPlayer current;
+		current.mPosition = packQuat(playerStates.getPosition(i));
+		current.mOrientation = packAngle(playerStates.mOrientations[i]);
+		current.mPoints = player.mPoints;
+		current.mState = (playerStates.mEnabled[i] ? 1 : 0) | (player.mIsAlive ? 2 : 0);
+
+		uint8_t fields = ALLPLAYERFIELDS;
+		if (!isKeyframe && i < mSentPlayers.size())
+		{
+			const SentPlayer& sent = mSentPlayers[i];
+			fields = 0;
+			if (current.mPosition != sent.mPosition)
+				fields |= PLAYER_POSITION;
+			if (current.mOrientation != sent.mOrientation)
+				fields |= PLAYER_ORIENTATION;
+			if (current.mPoints != sent.mPoints)
+				fields |= PLAYER_POINTS;
+			if (current.mState != sent.mState)
+				fields |= PLAYER_STATE;
+		}
+
+		if (fields == 0)
+			continue;
+
+		setBit(output, bitmapStart, i);
+		write(output, fields);
+		if (fields & PLAYER_POSITION)
+			writeQuat(output, current.mPosition);
+		if (fields & PLAYER_ORIENTATION)
+			write(output, current.mOrientation);
+		if (fields & PLAYER_POINTS)
+			write(output, current.mPoints);
+		if (fields & PLAYER_STATE)
+			write(output, current.mState);
+
+		if (i < mSentPlayers.size())
+			mSentPlayers[i] = current;
+		else
+			mSentPlayers.push_back(current);
+	}
+
+	//Collectibles, slots past numCollectibles keep their last sent values on both sides
+	bitmapStart = output.size();
+	output.resize(bitmapStart + (numCollectibles + 7) / 8, std::byte(0));
+	for (size_t i = 0; i < numCollectibles; i++)
+	{
+		SentCollectible current;
+		current.mPosition = packQuat(collectibleStates.getPosition(i));
+		current.mModelRotation = packQuat(collectibleStates.getModelRotation(i));
+		current.mModel = simulation.mCollectibleModels[i];
+
+		uint8_t fields = ALLCOLLECTIBLEFIELDS;
+		if (!isKeyframe && i < mSentCollectibles.size())
+		{
+			const SentCollectible& sent = mSentCollectibles[i];
+			fields = 0;
+			if (current.mPosition != sent.mPosition)
+				fields |= COLLECTIBLE_POSITION;
+			if (current.mModelRotation != sent.mModelRotation)
+				fields |= COLLECTIBLE_MODELROTATION;
+			if (current.mModel != sent.mModel)
+				fields |= COLLECTIBLE_MODEL;
+		}
+
+		if (fields == 0)
+			continue;
+
+		setBit(output, bitmapStart, i);
+		write(output, fields);
+		if (fields & COLLECTIBLE_POSITION)
+			writeQuat(output, current.mPosition);
+		if (fields & COLLECTIBLE_MODELROTATION)
+			writeQuat(output, current.mModelRotation);
+		if (fields & COLLECTIBLE_MODEL)
+			write(output, current.mModel);
+
+		if (i < mSentCollectibles.size())
+			mSentCollectibles[i] = current;
+		else
+			mSentCollectibles.push_back(current);
+	}
+
+	//Byte count benchmark against the old full state vectors
+	mEncodedBytes += output.size() - messageStart;
+	++mFrame;
+}
+
+bool StateSync::decode(Simulation& simulation, const std::vector<std::byte>& data, unsigned int& pos, double time)
+{
+	ZoneScoped;
+	uint8_t version, flags;
+	uint32_t frame;
+	double masterTime;
+	uint16_t numPlayers, numCollectibles;
+	if (!read(data, pos, version) || version != mVERSION)
+		return false;
+	if (!read(data, pos, flags) || !read(data, pos, frame) || !read(data, pos, masterTime) ||
+		!read(data, pos, numPlayers) || !read(data, pos, numCollectibles))
+		return false;
+
+	//A delta only applies on top of the message master sent right before it. After a gap,
+	//a rejected message or when joining late, deltas are dropped until the next keyframe
+	if (!(flags & FLAG_KEYFRAME) && (!mHasBase || frame != mLastFrame + 1))
+	{
+		if (!mIsWaitingForKeyframe)
+			sgct::Log::Warning("State sync frame %u is a delta without its base (last applied frame %u), "
+				"dropping deltas until the next keyframe",
+				frame, mLastFrame);
+		mIsWaitingForKeyframe = true;
+		mHasBase = false;
+		return true;
+	}
+	//Cleared until the message has been applied, a malformed one leaves no base
+	mHasBase = false;
+
+	//The whole message is read before anything is applied to simulation, a malformed one
+	//leaves it as it was. Roster entries of players not yet present on this node start at
+	//newPlayersPos, they are created in order once the rest has been read
+	const size_t numKnownPlayers = simulation.mPlayers.size();
+	size_t numRosterPlayers = numKnownPlayers;
+	unsigned int newPlayersPos = 0;
+	if (flags & FLAG_ROSTER)
+	{
+		uint16_t first, count;
+		if (!read(data, pos, first) || !read(data, pos, count))
+			return false;
+		if (first > numKnownPlayers)
+			return false;
+
+		for (size_t i = first; i < static_cast<size_t>(first) + count; i++)
+		{
+			uint8_t nameLength;
+			if (i == numKnownPlayers)
+				newPlayersPos = pos;
+			if (!read(data, pos, nameLength) || nameLength > NAMELIMIT)
+				return false;
+			if (pos + nameLength + 6 > data.size())
+				return false;
+			pos += nameLength + 6;
+		}
+		numRosterPlayers = std::max(numRosterPlayers, static_cast<size_t>(first) + count);
+	}
+
+	if (numPlayers > numRosterPlayers)
+		return false;
+
+	//Positions start out as the previous snapshot, arrays only ever grow so slots
+	//that are not enabled right now keep the values master last sent for them
+	SnapshotBuffer::Snapshot& snapshot = mSnapshots.beginSnapshot(masterTime);
+	if (snapshot.mPlayerPositions.size() < numPlayers)
+	{
+		snapshot.mPlayerPositions.resize(numPlayers, glm::quat(1.f, 0.f, 0.f, 0.f));
+		snapshot.mPlayerOrientations.resize(numPlayers, 0.f);
+	}
+	if (snapshot.mCollectiblePositions.size() < numCollectibles)
+	{
+		//Room for every slot, later spawns within the capacity don't allocate
+		const size_t capacity = std::max<size_t>(numCollectibles, simulation.getMaxCollectibles());
+		snapshot.mCollectiblePositions.reserve(capacity);
+		snapshot.mCollectibleRotations.reserve(capacity);
+		snapshot.mCollectibleModels.reserve(capacity);
+		snapshot.mCollectiblePositions.resize(numCollectibles, glm::quat(1.f, 0.f, 0.f, 0.f));
+		snapshot.mCollectibleRotations.resize(numCollectibles, glm::quat(1.f, 0.f, 0.f, 0.f));
+		snapshot.mCollectibleModels.resize(numCollectibles, 0);
+	}
+	snapshot.mNumCollectibles = numCollectibles;
+
+	//Players
+	mPendingPlayers.clear();
+	mPendingPlayers.reserve(numPlayers);
+	size_t bitmapStart = pos;
+	if (pos + (numPlayers + 7) / 8 > data.size())
+		return false;
+	pos += (numPlayers + 7) / 8;
+	for (size_t i = 0; i < numPlayers; i++)
+	{
+		if (!getBit(data, bitmapStart, i))
+			continue;
+
+		uint8_t fields;
+		if (!read(data, pos, fields))
+			return false;
+		//Points and state are applied with the roster, after the last check
+		PendingPlayer pending{ static_cast<uint32_t>(i), 0, 0, 0 };
+		if (fields & PLAYER_POSITION)
+		{
+			uint64_t bits;
+			if (!readQuat(data, pos, bits))
+				return false;
+			snapshot.mPlayerPositions[i] = unpackQuat(bits);
+		}
+		if (fields & PLAYER_ORIENTATION)
+		{
+			uint16_t bits;
+			if (!read(data, pos, bits))
+				return false;
+			snapshot.mPlayerOrientations[i] = unpackAngle(bits);
+		}
+		if (fields & PLAYER_POINTS)
+		{
+			if (!read(data, pos, pending.mPoints))
+				return false;
+			pending.mFields |= PLAYER_POINTS;
+		}
+		if (fields & PLAYER_STATE)
+		{
+			if (!read(data, pos, pending.mState))
+				return false;
+			pending.mFields |= PLAYER_STATE;
+		}
+		if (pending.mFields != 0)
+			mPendingPlayers.push_back(pending);
+	}
+
+	//Collectibles
+	bitmapStart = pos;
+	if (pos + (numCollectibles + 7) / 8 > data.size())
+		return false;
+	pos += (numCollectibles + 7) / 8;
+	for (size_t i = 0; i < numCollectibles; i++)
+	{
+		if (!getBit(data, bitmapStart, i))
+			continue;
+
+		uint8_t fields;
+		if (!read(data, pos, fields))
+			return false;
+		if (fields & COLLECTIBLE_POSITION)
+		{
+			uint64_t bits;
+			if (!readQuat(data, pos, bits))
+				return false;
+			snapshot.mCollectiblePositions[i] = unpackQuat(bits);
+		}
+		if (fields & COLLECTIBLE_MODELROTATION)
+		{
+			uint64_t bits;
+			if (!readQuat(data, pos, bits))
+				return false;
+			snapshot.mCollectibleRotations[i] = unpackQuat(bits);
+		}
+		if (fields & COLLECTIBLE_MODEL)
+		{
+			uint8_t model;
+			if (!read(data, pos, model))
+				return false;
+			snapshot.mCollectibleModels[i] = model;
+		}
+	}
+
+	//Master grew its collectibles, slots are only ever added
+	if (numCollectibles > simulation.getMaxCollectibles())
+		simulation.growCollectibles(numCollectibles - simulation.getMaxCollectibles());
+
+	for (size_t i = numKnownPlayers; i < numRosterPlayers; i++)
+	{
+		uint8_t nameLength;
+		read(data, newPlayersPos, nameLength);
+		std::string name(nameLength, ' ');
+		for (size_t c = 0; c < nameLength; c++)
+			name[c] = std::to_integer<char>(data[newPlayersPos + c]);
+		newPlayersPos += nameLength;
+
+		uint8_t rgb[6];
+		for (uint8_t& c : rgb)
+			read(data, newPlayersPos, c);
+
+		simulation.addPlayer(name, std::make_pair(
+			glm::vec3(unpackColour(rgb[0]), unpackColour(rgb[1]), unpackColour(rgb[2])),
+			glm::vec3(unpackColour(rgb[3]), unpackColour(rgb[4]), unpackColour(rgb[5]))));
+	}
+
+	for (const PendingPlayer& pending : mPendingPlayers)
+	{
+		Simulation::PlayerInfo& player = simulation.mPlayers[pending.mIndex];
+		if (pending.mFields & PLAYER_POINTS)
+			player.mPoints = pending.mPoints;
+		if (pending.mFields & PLAYER_STATE)
+		{
+			simulation.setEnabled(pending.mIndex, pending.mState & 1);
+			player.mIsAlive = pending.mState & 2;
+		}
+	}
+	mSnapshots.commitSnapshot();
+	mLastFrame = frame;
+	mHasBase = true;
+	mIsWaitingForKeyframe = false;
+
+	//Messages are received in the frame master sent them, so this is close to the
+	//difference between the clocks plus network delay
+	const double offset = masterTime - time;
+	mClockOffset = mHasClock ? mClockOffset + CLOCKSMOOTHING * (offset - mClockOffset) : offset;
+	mHasClock = true;
+
+	return true;
+}
+
+void StateSync::interpolate(Simulation& simulation, double time) const
+{
+	ZoneScoped;
+	if (mSnapshots.empty())
+		return;
+
+	const SnapshotBuffer::Snapshot* from;
+	const SnapshotBuffer::Snapshot* to;
+	float t = 1.f;
+	if (mInterpolate)
+	{
+		const double renderTime = time + mClockOffset - 1.5 * mInterval;
+		mSnapshots.bracket(renderTime, mMaxExtrapolation, from, to, t);
+	}
+	else
+	{
+		from = to = &mSnapshots.newest();
+	}
+
+	//Players
+	EntityStore& playerStates = simulation.mPlayerStates;
+	const size_t numPlayers = std::min(to->mPlayerPositions.size(), playerStates.size());
+	for (size_t i = 0; i < numPlayers; i++)
+	{
+		playerStates.setPosition(i, blendQuat(from->mPlayerPositions, to->mPlayerPositions, i, t));
+		playerStates.setOrientation(i, i < from->mPlayerOrientations.size()
+			? blendAngle(from->mPlayerOrientations[i], to->mPlayerOrientations[i], t)
+			: to->mPlayerOrientations[i]);
+	}
+
+	//Collectibles, slots only blend if they held the same collectible in both snapshots
+	EntityStore& collectibleStates = simulation.mCollectibleStates;
+	const size_t numCollectibles = to->mNumCollectibles;
+	for (size_t i = 0; i < numCollectibles; i++)
+	{
+		const bool sameObject = i < from->mNumCollectibles &&
+			from->mCollectibleModels[i] == to->mCollectibleModels[i];
+		const SnapshotBuffer::Snapshot& blendFrom = sameObject ? *from : *to;
+
+		collectibleStates.setPosition(i,
+			blendQuat(blendFrom.mCollectiblePositions, to->mCollectiblePositions, i, t));
+		collectibleStates.setModelRotation(i,
+			blendQuat(blendFrom.mCollectibleRotations, to->mCollectibleRotations, i, t));
+
+		simulation.mCollectibleModels[i] = to->mCollectibleModels[i];
+	}
+
+	//No need to disable any unactive elements as nodes only render
+	simulation.mNumCollectibles = numCollectibles;
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "glm/glm.hpp"
+#include <glm/gtc/quaternion.hpp>
+
+#include "snapshotbuffer.hpp"
+
+class Simulation;
+
+//Binary, delta compressed cluster synchronisation of the game state
+//
+//The master encodes one message per frame, the nodes decode it and apply it to their
+//Simulation, which Game renders from.
+//Only fields whose quantized value changed since the previous message are sent, every
+//mKEYFRAMEINTERVAL frames all fields are sent. Names and colours only change when players
+//join, they are sent in a separate roster section when that happens and on keyframes.
+//A node only applies a delta on top of the frame before it, after a missed or rejected
+//message it waits for the next keyframe.
+//
+//The master can send at a lower rate than it renders. Nodes keep the last few decoded
+//states in a SnapshotBuffer and render slightly behind master time, interpolating
+//positions and orientations between snapshots (extrapolating briefly on gaps).
+//
+//Layout of a message (little endian):
+//  Header:       u8 version, u8 flags, u32 frame, f64 master time,
+//                u16 numPlayers, u16 numCollectibles
+//  Roster:       (if FLAG_ROSTER) u16 first, u16 count, count * { u8 nameLength, name,
+//                u8 primary rgb[3], u8 secondary rgb[3] }
+//  Players:      changed bitmap (1 bit per player), then per changed player a u8 field
+//                mask followed by the fields in PlayerField order
+//  Collectibles: same as players using CollectibleField
+//
+//Quaternions are sent as "smallest three": the index of the largest component (2 bits)
+//and the three others quantized to mQUATBITS bits each, packed into 6 bytes
+class StateSync
+{
+public:
+	static constexpr uint8_t mVERSION = 2;
+	static constexpr uint32_t mKEYFRAMEINTERVAL = 300;
+	static constexpr unsigned mQUATBITS = 15;
+
+	//Rotations larger than this (radians) between two snapshots are not interpolated,
+	//the object was swapped or respawned rather than moved
+	static constexpr float mSNAPANGLE = 0.5f;
+
+	//Messages per second sent by master, 0 sends one every frame
+	//Nodes render 1.5 intervals behind master so there is usually a snapshot on each side
+	void setRate(float rate);
+
+	//Node: blend between snapshots (otherwise show the newest) and how far past the
+	//newest snapshot to extrapolate when the next one is late (seconds)
+	void setInterpolation(bool enabled, double maxExtrapolation);
+
+	//Master: append the message for this frame to output, if one is due at time
+	//output is reserved for the worst case up front, so it grows at most once per call
+	//and not at all if the caller reserved maxMessageSize() already
+	void encode(const Simulation& simulation, std::vector<std::byte>& output, double time);
+
+	//Node: read a message starting at pos, received at local time
+	//Points, player state and roster are applied to simulation, positions go to the snapshot
+	//buffer. Returns false and changes nothing if the message is malformed
+	//Deltas that don't follow the last applied message are skipped until the next keyframe
+	bool decode(Simulation& simulation, const std::vector<std::byte>& data, unsigned int& pos, double time);
+
+	//Node: write the positions for local time into simulation, once per frame before rendering
+	void interpolate(Simulation& simulation, double time) const;
+
+	//Upper bound on the size of one message, a keyframe with every field of every entity
+	static size_t maxMessageSize(size_t numPlayers, size_t numCollectibles);
+	static size_t maxMessageSize(const Simulation& simulation);
+
+	//Quantization helpers
+	static uint64_t packQuat(const glm::quat& q);
+	static glm::quat unpackQuat(uint64_t bits);
+	static uint16_t packAngle(float angle);
+	static float unpackAngle(uint16_t bits);
+	static uint8_t packColour(float c);
+	static float unpackColour(uint8_t c);
+
+	//Bytes written by encode() so far, and the size the old SyncableData vectors
+	//would have had for the same frames
+	uint64_t getEncodedBytes() const { return mEncodedBytes; }
+	uint64_t getLegacyBytes() const { return mLegacyBytes; }
+	uint32_t getEncodedFrames() const { return mFrame; }
+	uint64_t getEncodeCalls() const { return mEncodeCalls; }
+
+private:
+	enum Flags : uint8_t
+	{
+		FLAG_KEYFRAME = 1 << 0,
+		FLAG_ROSTER = 1 << 1
+	};
+
+	enum PlayerField : uint8_t
+	{
+		PLAYER_POSITION = 1 << 0,    //6 bytes, packed quaternion
+		PLAYER_ORIENTATION = 1 << 1, //u16, packed angle
+		PLAYER_POINTS = 1 << 2,      //i32
+		PLAYER_STATE = 1 << 3        //u8, bit 0 enabled, bit 1 alive
+	};
+
+	enum CollectibleField : uint8_t
+	{
+		COLLECTIBLE_POSITION = 1 << 0,      //6 bytes, packed quaternion
+		COLLECTIBLE_MODELROTATION = 1 << 1, //6 bytes, packed quaternion
+		COLLECTIBLE_MODEL = 1 << 2          //u8, slot in ModelManager
+	};
+
+	//Last quantized values sent for a slot, the nodes hold exactly these values
+	struct SentPlayer
+	{
+		uint64_t mPosition;
+		uint16_t mOrientation;
+		int32_t mPoints;
+		uint8_t mState;
+	};
+	struct SentCollectible
+	{
+		uint64_t mPosition;
+		uint64_t mModelRotation;
+		uint8_t mModel;
+	};
+
+	//Seconds between messages, 0 for every frame
+	double mInterval = 0.0;
+
+	//Master state
+	uint32_t mFrame = 0;
+	uint64_t mEncodeCalls = 0;
+	double mNextEncodeTime = 0.0;
+	size_t mRosterSize = 0;
+	std::vector<SentPlayer> mSentPlayers;
+	std::vector<SentCollectible> mSentCollectibles;
+	uint64_t mEncodedBytes = 0;
+	uint64_t mLegacyBytes = 0;
+
+	//Node state, the newest snapshot is also the base the next delta is applied to
+	SnapshotBuffer mSnapshots;
+	//Points and state read by decode(), applied once the whole message has been read
+	struct PendingPlayer
+	{
+		uint32_t mIndex;
+		uint8_t mFields;
+		int32_t mPoints;
+		uint8_t mState;
+	};
+	std::vector<PendingPlayer> mPendingPlayers;
+	//Frame of the last applied message, only a valid base for the next delta if mHasBase
+	uint32_t mLastFrame = 0;
+	bool mHasBase = false;
+	bool mIsWaitingForKeyframe = false;
+	bool mInterpolate = true;
+	double mMaxExtrapolation = 0.25;
+
+	//Estimate of master time minus local time, smoothed over received messages
+	double mClockOffset = 0.0;
+	bool mHasClock = false;
+
+	//Writing and reading of little endian values
+	template<typename T>
+	static void write(std::vector<std::byte>& out, T value);
+	static void writeQuat(std::vector<std::byte>& out, uint64_t bits);
+
+	template<typename T>
+	static bool read(const std::vector<std::byte>& data, unsigned int& pos, T& value);
+	static bool readQuat(const std::vector<std::byte>& data, unsigned int& pos, uint64_t& bits);
+};
+
+template<typename T>
+void StateSync::write(std::vector<std::byte>& out, T value)
+{
+	const size_t offset = out.size();
+	out.resize(offset + sizeof(T));
+	std::memcpy(out.data() + offset, &value, sizeof(T));
+}
+
+template<typename T>
+bool StateSync::read(const std::vector<std::byte>& data, unsigned int& pos, T& value)
+{
+	if (pos + sizeof(T) > data.size())
+		return false;
+	std::memcpy(&value, data.data() + pos, sizeof(T));
+	pos += sizeof(T);
+	return true;
+}
@@ -30,13 +30,18 @@
 
 #include "websockethandler.h"
 
+#include <sgct/log.h>
 #include <sgct/profiling.h>
 #include "libwebsockets.h"
+#include "messagering.hpp"
+#include "spscqueue.hpp"
 #include <algorithm>
 #include <assert.h>
+#include <atomic>
 #include <exception>
 #include <mutex>
 #include <string_view>
+#include <thread>
 #include <vector>
 
 /// Private implementation (=pimpl) of the WebSocketHandler to hide all details in here
@@ -46,11 +51,13 @@ struct WebSocketHandlerImpl {
     /// Port at which to connect
     int port = 0;
 
-    /// Mutex that protects simulteanoues access to the messageQueue
+    /// Mutex that protects simulteanoues access to the messageQueue.  Not used in the
+    /// threaded mode, where only the network thread touches the messageQueue
     std::mutex messageMutex;
-    /// The queued list of messages that will be sent one-by-one, whenever the sockets
-    /// reports that it is ready to be written to
-    std::vector<std::vector<std::byte>> messageQueue;
+    /// The queued messages, stored once with the LWS_PRE padding libwebsockets needs in
+    /// front. Whenever the socket reports that it is ready to be written to, everything
+    /// queued since the last write is sent as one binary batch of length-prefixed frames
+    MessageRing messageQueue{ 64 * 1024, LWS_PRE };
 
     /// The user's function pointer that is called when a connection is established
     std::function<void()> connectionEstablished;
@@ -60,13 +67,37 @@ struct WebSocketHandlerImpl {
     /// includes the data of the message
     std::function<void(const void*, size_t)> messageReceived;
 
-    bool isConnected = false;
+    /// In the threaded mode, libwebsockets is serviced on this thread only.  Messages
+    /// cross between it and the thread calling #tick and #queueMessage through the
+    /// lock-free queues below, so neither side ever waits for the other
+    std::thread networkThread;
+    std::atomic_bool stopNetworkThread = false;
+    bool isThreaded = false;
+    /// Copy of the context for the thread calling #tick, which must not read #context
+    /// while the network thread may clear it
+    lws_context* networkContext = nullptr;
+    /// A received message and the time it was read from the socket
+    struct InboundMessage {
+        std::vector<std::byte> data;
+        std::chrono::system_clock::time_point receiveTime;
+    };
+    /// Received messages waiting for the next #tick, filled by the network thread
+    SpscQueue<InboundMessage> inbound{ 1024 };
+    /// Time of the message being passed to messageReceived, see #receiveTime
+    std::chrono::system_clock::time_point receiveTime;
+    /// Messages from #queueMessage waiting to be moved into the messageQueue
+    SpscQueue<std::vector<std::byte>> outbound{ 4096 };
+    /// Messages that did not fit in the queues above, reported on the next #tick
+    std::atomic<size_t> droppedInbound = 0;
+    size_t droppedOutbound = 0;
+
+    std::atomic_bool isConnected = false;
 
     /// The disconnect method sets this to \c true.  We can't disconnect the socket
     /// directly, but have to wait for a round-trip through the callback method, which
     /// needs to return -1 in order to signal to libwebsocket that it should close it.
     /// ¯\_(ツ)_/¯
-    bool wantsToDisconnect = false;
+    std::atomic_bool wantsToDisconnect = false;
 
     /// A pointer to the context that contains our protocol and connection
     lws_context* context = nullptr;
@@ -88,7 +119,10 @@ int callback(lws* wsi, lws_callback_reasons reason, void* u, void* in, size_t le
     void* usr = lws_get_protocol(wsi) ? lws_get_protocol(wsi)->user : nullptr;
     WebSocketHandlerImpl* pImpl = reinterpret_cast<WebSocketHandlerImpl*>(usr);
 
-    if (pImpl && pImpl->wantsToDisconnect) {
+    // Only a -1 from a callback of the connection itself closes it.  Others, like the
+    // context wide LWS_CALLBACK_EVENT_WAIT_CANCELLED, leave the flag for the connection's
+    // next callback
+    if (pImpl && pImpl->wantsToDisconnect && wsi == pImpl->connection) {
         pImpl->wantsToDisconnect = false;
         return -1;
     }
@@ -102,37 +136,64 @@ int callback(lws* wsi, lws_callback_reasons reason, void* u, void* in, size_t le
             break;
         case LWS_CALLBACK_CLIENT_RECEIVE:
             assert(pImpl);
-            pImpl->messageReceived(in, len);
+            if (pImpl->isThreaded) {
+                // Handed to the user's callback in the next tick() on their thread
+                WebSocketHandlerImpl::InboundMessage* slot = pImpl->inbound.back();
+                if (!slot) {
+                    pImpl->droppedInbound++;
+                    break;
+                }
+                const std::byte* data = reinterpret_cast<const std::byte*>(in);
+                slot->data.assign(data, data + len);
+                slot->receiveTime = std::chrono::system_clock::now();
+                pImpl->inbound.push();
+            }
+            else {
+                pImpl->receiveTime = std::chrono::system_clock::now();
+                pImpl->messageReceived(in, len);
+            }
             break;
+        case LWS_CALLBACK_EVENT_WAIT_CANCELLED:
+        {
+            // tick() and disconnect() wake the network thread with lws_cancel_service,
+            // which is the only libwebsockets call that is safe from another thread.
+            // A pending disconnect is handled in the writable callback this asks for
+            WebSocketHandlerImpl* impl = reinterpret_cast<WebSocketHandlerImpl*>(
+                lws_context_user(lws_get_context(wsi))
+            );
+            if (impl && impl->isThreaded && impl->connection) {
+                lws_callback_on_writable(impl->connection);
+            }
+            break;
+        }
         case LWS_CALLBACK_CLIENT_WRITEABLE:
         {
             ZoneScopedN("Write to WebSocket")
 
             assert(pImpl);
-            std::lock_guard lock(pImpl->messageMutex);
-            if (pImpl->messageQueue.empty()) {
+            std::unique_lock lock(pImpl->messageMutex, std::defer_lock);
+            if (pImpl->isThreaded) {
+                while (std::vector<std::byte>* msg = pImpl->outbound.front()) {
+                    pImpl->messageQueue.push(msg->data(), msg->size());
+                    pImpl->outbound.pop();
+                }
+            }
+            else {
+                lock.lock();
+            }
+
+            size_t size = 0;
+            std::byte* batch = pImpl->messageQueue.frontBatch(size);
+            if (!batch) {
                 break;
             }
 
-            // Get a copy of first message from the queue.  Don't change this into a
-            // reference or we will have a dangling reference after the following erase
-            std::vector<std::byte> msg = pImpl->messageQueue.front();
-            pImpl->messageQueue.erase(pImpl->messageQueue.begin());
-
-            // Libwebsocket requires a padding in the beginning to include
-            // websocket-related information.  This is seems quite a dirty way of handling
-            // this, but what do I know ¯\_(ツ)_/¯
-            std::vector<std::byte> buffer(LWS_PRE + msg.size());
-            // Null out the entire block, just to be sure we don't send any garbage
-            std::fill(buffer.begin(), buffer.end(), std::byte(0));
-            // Insert the message in the middle block
-            std::copy(msg.begin(), msg.end(), buffer.begin() + LWS_PRE);
-
-            // Send the message.
-            // Yes, we have to pass the pointer past the padding and send the size of the
-            // message, not the buffer...  that is not an error -.-
-            unsigned char* p = reinterpret_cast<unsigned char*>(buffer.data() + LWS_PRE);
-            lws_write(wsi, p, msg.size(), LWS_WRITE_TEXT);
+            // The queue keeps LWS_PRE bytes free in front of the batch, so libwebsockets
+            // can put its header there without another copy.  We pass the pointer past
+            // the padding and the size of the batch, not of the buffer
+            unsigned char* p = reinterpret_cast<unsigned char*>(batch);
+            lws_write(wsi, p, size, LWS_WRITE_BINARY);
+            pImpl->messageQueue.popBatch();
             break;
         }
         case LWS_CALLBACK_CLIENT_CLOSED:
@@ -187,16 +248,25 @@ WebSocketHandler::WebSocketHandler(std::string address, int port,
 
 WebSocketHandler::~WebSocketHandler() {
     disconnect();
-    tick();
+    if (_pImpl->isThreaded) {
+        // Destroying the context below closes the connection if the thread didn't
+        _pImpl->stopNetworkThread = true;
+        lws_cancel_service(_pImpl->networkContext);
+        _pImpl->networkThread.join();
+    }
+    else {
+        tick();
+    }
 
     lws_context_destroy(_pImpl->context);
     _pImpl = nullptr;
 }
 
-bool WebSocketHandler::connect(std::string protocolName, int bufferSize) {
+bool WebSocketHandler::connect(std::string protocolName, int bufferSize, bool threaded) {
     ZoneScoped
 
     assert(bufferSize >= 0);
+    assert(!_pImpl->networkThread.joinable());
 
     lws_context_creation_info info;
     std::memset(&info, 0, sizeof(info));
@@ -215,6 +285,8 @@ bool WebSocketHandler::connect(std::string protocolName, int bufferSize) {
     info.protocols = protocols;
     info.gid = -1;
     info.uid = -1;
+    // Lets the callback find us for context-wide events that belong to no connection
+    info.user = _pImpl.get();
 
     _pImpl->context = lws_create_context(&info);
     lws_client_connect_info ccinfo;
@@ -228,11 +300,34 @@ bool WebSocketHandler::connect(std::string protocolName, int bufferSize) {
     ccinfo.protocol = protocols[0].name;
 
     _pImpl->connection = lws_client_connect_via_info(&ccinfo);
-    return _pImpl->connection != nullptr;
+    if (!_pImpl->connection) {
+        return false;
+    }
+
+    _pImpl->isThreaded = threaded;
+    _pImpl->networkContext = _pImpl->context;
+    if (threaded) {
+        // From here on only the network thread calls into libwebsockets, apart from
+        // lws_cancel_service to wake it up
+        _pImpl->networkThread = std::thread([impl = _pImpl.get()]() {
+#ifdef TRACY_ENABLE
+            tracy::SetThreadName("Network");
+#endif
+            while (!impl->stopNetworkThread && impl->context) {
+                lws_service(impl->networkContext, 0);
+            }
+        });
+    }
+    return true;
 }
 
 void WebSocketHandler::disconnect() {
-    if (_pImpl->context && _pImpl->connection) {
+    if (_pImpl->isThreaded) {
+        // The network thread picks this up in the callback it is woken up for
+        _pImpl->wantsToDisconnect = true;
+        lws_cancel_service(_pImpl->networkContext);
+    }
+    else if (_pImpl->context && _pImpl->connection) {
         _pImpl->wantsToDisconnect = true;
         lws_callback_on_writable(_pImpl->connection);
     }
@@ -245,6 +340,27 @@ bool WebSocketHandler::isConnected() const {
 void WebSocketHandler::tick() {
     ZoneScoped
 
+    if (_pImpl->isThreaded) {
+        while (WebSocketHandlerImpl::InboundMessage* msg = _pImpl->inbound.front()) {
+            _pImpl->receiveTime = msg->receiveTime;
+            _pImpl->messageReceived(msg->data.data(), msg->data.size());
+            _pImpl->inbound.pop();
+        }
+
+        const size_t droppedInbound = _pImpl->droppedInbound.exchange(0);
+        if (droppedInbound > 0 || _pImpl->droppedOutbound > 0) {
+            sgct::Log::Warning(
+                "WebSocket queues full, dropped %zu received and %zu queued messages",
+                droppedInbound, _pImpl->droppedOutbound
+            );
+            _pImpl->droppedOutbound = 0;
+        }
+
+        // Let the network thread send what was queued since the last tick
+        lws_cancel_service(_pImpl->networkContext);
+        return;
+    }
+
     if (_pImpl->context && _pImpl->connection) {
         lws_callback_on_writable(_pImpl->connection);
         lws_service(_pImpl->context, 0);
@@ -252,21 +368,38 @@ void WebSocketHandler::tick() {
 }
 
 void WebSocketHandler::queueMessage(std::string message) {
-    std::vector<std::byte> msg(message.size());
-    std::transform(
-        message.begin(), message.end(),
-        msg.begin(),
-        [](char c) { return static_cast<std::byte>(c); }
-    );
-    queueMessage(std::move(msg));
+    queueMessage(reinterpret_cast<const std::byte*>(message.data()), message.size());
 }
 
 void WebSocketHandler::queueMessage(std::vector<std::byte> message) {
+    queueMessage(message.data(), message.size());
+}
+
+void WebSocketHandler::queueMessage(const std::byte* data, size_t size) {
+    if (_pImpl->isThreaded) {
+        std::vector<std::byte>* slot = _pImpl->outbound.back();
+        if (!slot) {
+            _pImpl->droppedOutbound++;
+            return;
+        }
+        slot->assign(data, data + size);
+        _pImpl->outbound.push();
+        return;
+    }
+
     std::lock_guard lock(_pImpl->messageMutex);
-    _pImpl->messageQueue.push_back(std::move(message));
+    _pImpl->messageQueue.push(data, size);
+}
+
+std::chrono::system_clock::time_point WebSocketHandler::receiveTime() const {
+    return _pImpl->receiveTime;
 }
 
 int WebSocketHandler::queueSize() const {
+    if (_pImpl->isThreaded) {
+        return static_cast<int>(_pImpl->outbound.size());
+    }
+
     std::lock_guard lock(_pImpl->messageMutex);
     return static_cast<int>(_pImpl->messageQueue.size());
 }
@@ -31,6 +31,7 @@
 #ifndef __WEBSOCKETHANDLER_H__
 #define __WEBSOCKETHANDLER_H__
 
+#include <chrono>
 #include <functional>
 #include <memory>
 #include <string>
@@ -49,6 +50,15 @@ struct WebSocketHandlerImpl;
  * After that, the #tick method has to be called regularly (preferrably every frame) by
  * your application to be able to receive messages.
  *
+ * If #connect is called with <code>threaded</code> set, the socket is serviced on a
+ * separate network thread instead, so that slow network operations never stall the
+ * thread calling #tick.  Received messages are then only passed to
+ * <code>messageReceived</code> from within #tick, on the calling thread, and
+ * #queueMessage has to be called from that same thread.  Messages move between the
+ * threads through fixed-size lock-free queues and are dropped with a warning if these
+ * fill up.  The <code>connectionEstablished</code> and <code>connectionClosed</code>
+ * callbacks are called on the network thread in this mode.
+ *
  * If you want send a message to the client, you can queue a message to be sent using the
  * #queueMessage method, which will add the message to the queue handled internally.  At
  * any point you can query the size of the queue through the #queueSize method.
@@ -74,15 +84,21 @@ public:
 
     ~WebSocketHandler();
 
-    bool connect(std::string protocolName, int bufferSize);
+    bool connect(std::string protocolName, int bufferSize, bool threaded = false);
     void disconnect();
     bool isConnected() const;
     void tick();
 
     void queueMessage(std::string message);
     void queueMessage(std::vector<std::byte> message);
+    void queueMessage(const std::byte* data, size_t size);
     int queueSize() const;
 
+    /// The time at which the message currently passed to <code>messageReceived</code>
+    /// was read from the socket.  Only meaningful inside that callback; in the threaded
+    /// mode this is earlier than the #tick that delivers the message
+    std::chrono::system_clock::time_point receiveTime() const;
+
 private:
     std::unique_ptr<WebSocketHandlerImpl> _pImpl;
 };
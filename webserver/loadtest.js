@@ -0,0 +1,161 @@
+'use strict'
+
+//
+// Load test of the relay: starts server.js, connects a fake game and synthetic phones to
+// it on this machine and logs the CPU time the relay uses.
+// Usage: node loadtest.js [clients, comma separated] [seconds per run] [port]
+// ex: node loadtest.js 110,500 20
+//
+const { spawn } = require('child_process');
+const WebSocketClient = require('websocket').client;
+
+const clientCounts = (process.argv[2] || '110,500').split(',').map(Number);
+const duration = Number(process.argv[3] || 20);
+const port = Number(process.argv[4] || 8090);
+
+//Frame rate of the fake game and rate of turn input from each phone (Hz)
+const gameRate = 60;
+const turnRate = 30;
+//Fraction of the players whose score changes each frame
+const scoreChanges = 0.1;
+
+function connect(protocol) {
+  return new Promise(function (resolve, reject) {
+    const client = new WebSocketClient();
+    client.on('connect', resolve);
+    client.on('connectFailed', reject);
+    client.connect(`ws://127.0.0.1:${port}/`, protocol);
+  });
+}
+
+//Messages as the game would queue them, see src/servermessages.hpp, each prefixed by
+//its length as in src/messagering.hpp
+function frame(message) {
+  const length = Buffer.alloc(2);
+  length.writeUInt16LE(message.length, 0);
+  return [length, message];
+}
+
+function scoreboard(ids, time) {
+  const message = Buffer.alloc(8 + 6 * ids.length);
+  message.write('S', 0);
+  message.writeUInt8(1, 1);
+  message.writeUInt16LE(ids.length, 2);
+  message.writeFloatLE(time, 4);
+  ids.forEach(function (id, i) {
+    message.writeUInt16LE(id, 8 + 6 * i);
+    message.writeInt32LE(Math.floor(Math.random() * 1000), 10 + 6 * i);
+  });
+  return frame(message);
+}
+
+function roster(ids) {
+  const message = Buffer.alloc(4 + 8 * ids.length);
+  message.write('R', 0);
+  message.writeUInt16LE(ids.length, 2);
+  ids.forEach(function (id, i) {
+    message.writeUInt16LE(id, 4 + 8 * i);
+    message.fill(200, 6 + 8 * i, 12 + 8 * i);
+  });
+  return frame(message);
+}
+
+//Stand in for the game, answers joins with a roster and sends a scoreboard every frame
+async function startGame(stats) {
+  const game = await connect('example-protocol');
+  const players = [];
+  let newPlayers = [];
+  game.on('message', function (msg) {
+    stats.gameReceived++;
+    if (msg.type === 'binary' && msg.binaryData[0] === 'I'.charCodeAt(0)) {
+      newPlayers.push(msg.binaryData.readUInt32LE(4));
+    }
+  });
+
+  const start = Date.now();
+  const timer = setInterval(function () {
+    let parts = [];
+    if (newPlayers.length > 0) {
+      parts = parts.concat(roster(newPlayers));
+      players.push(...newPlayers);
+      newPlayers = [];
+    }
+    const changed = players.filter(() => Math.random() < scoreChanges);
+    parts = parts.concat(scoreboard(changed, (Date.now() - start) / 1000));
+    game.sendBytes(Buffer.concat(parts));
+  }, 1000 / gameRate);
+
+  return { close: function () { clearInterval(timer); game.close(); } };
+}
+
+//A phone that joins and then turns at turnRate
+async function startPhone(index, stats) {
+  const phone = await connect();
+  phone.on('message', function () { stats.phoneReceived++; });
+  phone.send(`N bot${index}`);
+  const timer = setInterval(function () {
+    phone.send(`C ${(Math.random() * 2 - 1).toFixed(3)}`);
+  }, 1000 / turnRate);
+  return { close: function () { clearInterval(timer); phone.close(); } };
+}
+
+function run(clients) {
+  return new Promise(function (resolve) {
+    const relay = spawn(process.execPath, ['server.js'], {
+      cwd: __dirname,
+      env: Object.assign({}, process.env, {
+        RELAY_CONFIG: JSON.stringify({
+          serverPort: port, gameAddress: '', allowSameAddress: true, logLoad: true
+        })
+      })
+    });
+
+    const stats = { gameReceived: 0, phoneReceived: 0 };
+    const samples = [];
+    let connections = [];
+    let started = false;
+    let measuring = false;
+
+    relay.stdout.on('data', async function (data) {
+      const text = data.toString();
+      for (const match of text.matchAll(/load cpu ([\d.]+)/g)) {
+        if (measuring) {
+          samples.push(parseFloat(match[1]));
+        }
+      }
+      if (started || text.indexOf('Server is listening') === -1) {
+        return;
+      }
+      started = true;
+
+      connections.push(await startGame(stats));
+      for (let i = 0; i < clients; i++) {
+        connections.push(await startPhone(i, stats));
+      }
+      console.log(`${clients} clients connected, measuring for ${duration} s`);
+      stats.gameReceived = 0;
+      stats.phoneReceived = 0;
+      measuring = true;
+
+      setTimeout(function () {
+        measuring = false;
+        connections.forEach(c => c.close());
+        relay.kill();
+
+        const mean = samples.reduce((a, b) => a + b, 0) / Math.max(samples.length, 1);
+        const max = Math.max(0, ...samples);
+        console.log(`${clients} clients: relay cpu mean ${mean.toFixed(1)} %, max ${max.toFixed(1)} %, ` +
+          `${(stats.gameReceived / duration).toFixed(0)} msg/s to the game, ` +
+          `${(stats.phoneReceived / duration).toFixed(0)} msg/s to the phones`);
+        resolve();
+      }, duration * 1000);
+    });
+    relay.stderr.pipe(process.stderr);
+  });
+}
+
+(async function () {
+  for (const clients of clientCounts) {
+    await run(clients);
+  }
+})();
@@ -11,6 +11,7 @@ const app = express();
 const server = require('http').Server(app);
 const WebSocketServer = require('websocket').server;
 const assert = require('assert').strict;
+const { performance } = require('perf_hooks');
 
 //Give each player a unique id, gets incremented on every new connection
 global.uniqueId = 0;
@@ -21,10 +22,15 @@ global.playerList = new Map(); // {"ip", id}
 //
 //
 var config = JSON.parse(fs.readFileSync('config.json'));
+//RELAY_CONFIG holds JSON that overrides config.json, loadtest.js uses it
+Object.assign(config, JSON.parse(process.env.RELAY_CONFIG || '{}'));
 console.log(config.gameAddress);
 console.log(config.serverAddress);
 const port = config.serverPort;
 const gameAddress = config.gameAddress;
+//Player messages to the game use the binary format in src/inputprotocol.hpp,
+//set "binaryInput": false in config.json to send the old text messages instead
+const binaryInput = config.binaryInput !== false;
 
 app.use(express.static(__dirname + '/public'));
 
@@ -43,28 +49,151 @@ server.listen(port, function () {
 var gameSocket = null;
 var connectionArray = [];
 
-var wsServer = new WebSocketServer({ httpServer: server });
-wsServer.on('request', function (req) {
-  if (req.remoteAddress === gameAddress) {
-    console.log('Game connection established');
+//Split a batch from the game into its messages. Each is prefixed by its length as a
+//16 bit integer, see src/messagering.hpp. Scoreboard (S), roster (R) and echo (Y)
+//messages are decoded as in src/servermessages.hpp, the others are text
+function parseGameBatch(data) {
+  const messages = [];
+  let pos = 0;
+  while (pos + 2 <= data.length) {
+    const length = data.readUInt16LE(pos);
+    const frame = data.subarray(pos + 2, pos + 2 + length);
+    pos += 2 + length;
+
+    const type = String.fromCharCode(frame[0]);
+    if (type === 'S') {
+      const count = frame.readUInt16LE(2);
+      const scores = new Map();
+      for (let i = 0; i < count; i++) {
+        scores.set(frame.readUInt16LE(8 + 6 * i), frame.readInt32LE(10 + 6 * i));
+      }
+      const time = (frame[1] & 1) ? frame.readFloatLE(4) : null;
+      messages.push({ type, time, scores });
+    } else if (type === 'R') {
+      const count = frame.readUInt16LE(2);
+      const colours = new Map();
+      for (let i = 0; i < count; i++) {
+        const offset = 4 + 8 * i;
+        colours.set(frame.readUInt16LE(offset), [
+          [frame[offset + 2], frame[offset + 3], frame[offset + 4]],
+          [frame[offset + 5], frame[offset + 6], frame[offset + 7]]
+        ]);
+      }
+      messages.push({ type, colours });
+    } else if (type === 'Y') {
+      messages.push({ type, id: frame.readUInt16LE(2), text: frame.toString('utf8', 4) });
+    } else {
+      messages.push({ type, text: frame.toString('utf8') });
+    }
+  }
+  return messages;
+}
+
+var inputSequence = 0;
+
+//Send a player message (N, C, D, I or Y) to the game, name is the token for Y
+function sendToGame(type, id, value = 0, name = '') {
+  if (!binaryInput) {
+    if (type === 'N' || type === 'Y') gameSocket.send(`${type} ${id} ${name}`);
+    else if (type === 'C') gameSocket.send(`C ${id} ${value}`);
+    else gameSocket.send(`${type} ${id}`);
+    return;
+  }
 
-    gameSocket = req.accept("example-protocol", req.origin);
+  //24 byte header: type, version, name length, id, sequence, value, send time in
+  //microseconds since the epoch (for the latency stats on the master). Then the name
+  const nameBytes = Buffer.from(name, 'utf8');
+  const message = Buffer.alloc(24 + nameBytes.length);
+  message.writeUInt8(type.charCodeAt(0), 0);
+  message.writeUInt8(2, 1);
+  message.writeUInt16LE(nameBytes.length, 2);
+  message.writeUInt32LE(id, 4);
+  message.writeUInt32LE(inputSequence, 8);
+  message.writeFloatLE(value, 12);
+  message.writeBigUInt64LE(BigInt(Math.round((performance.timeOrigin + performance.now()) * 1000)), 16);
+  nameBytes.copy(message, 24);
+  inputSequence = (inputSequence + 1) >>> 0;
+  gameSocket.sendBytes(message);
+}
+
+//Phones by player id, each game message is routed to its player through this
+//instead of every connection looking at every message
+const playerConnections = new Map(); // {id, connection}
+
+//Send text to the phone of player id, if it is still connected
+function sendToPlayer(id, text) {
+  const connection = playerConnections.get(id);
+  if (connection && connection.connected) {
+    connection.send(text);
+  }
+}
 
-    gameSocket.on('message', function(msg) {
-      if (msg.type === 'utf8') {
-        if (msg.utf8Data === 'ping') {
-          gameSocket.send('pong');
-        }
+//Send text to every connected phone, joined or not
+function broadcast(text) {
+  for (const connection of connectionArray) {
+    connection.send(text);
+  }
+}
+
+//Route one batch from the game, see parseGameBatch
+function dispatchGameMessage(msg) {
+  if (msg.type === 'utf8') {
+    if (msg.utf8Data === 'ping') {
+      gameSocket.send('pong');
+    } else if (msg.utf8Data === 'game_connect') {
+      gameSocket.send('Game connection established');
+    }
+    return;
+  }
+
+  for (const message of parseGameBatch(msg.binaryData)) {
+    // Colours of new players
+    if (message.type === 'R') {
+      for (const [id, colours] of message.colours) {
+        sendToPlayer(id, `A ${colours[0]}`);
+        sendToPlayer(id, `B ${colours[1]}`);
       }
-    });
 
-    gameSocket.on('message', function(msg) {
-      if (msg.type === 'utf8') {
-        if (msg.utf8Data === 'game_connect') {
-          gameSocket.send('Game connection established');
-        }
+      // Changed scores go to their players, the timer to everyone
+    } else if (message.type === 'S') {
+      for (const [id, points] of message.scores) {
+        sendToPlayer(id, `P ${points}`);
       }
-    });
+      if (message.time !== null) {
+        broadcast(`T ${message.time.toFixed(2)}`);
+      }
+    } else if (message.type === 'Y') {
+      sendToPlayer(message.id, `Y ${message.text}`);
+    } else if (message.type === 'U') {
+      broadcast(message.text);
+    }
+  }
+}
+
+//With "logLoad": true the CPU time of the relay is logged every second, used by loadtest.js
+if (config.logLoad) {
+  let lastUsage = process.cpuUsage();
+  let lastTime = performance.now();
+  setInterval(function () {
+    const usage = process.cpuUsage(lastUsage);
+    const now = performance.now();
+    const percent = (usage.user + usage.system) / ((now - lastTime) * 10);
+    console.log(`load cpu ${percent.toFixed(1)} phones ${playerConnections.size}`);
+    lastUsage = process.cpuUsage();
+    lastTime = now;
+  }, 1000);
+}
+
+var wsServer = new WebSocketServer({ httpServer: server });
+wsServer.on('request', function (req) {
+  // The game asks for its protocol, which tells it apart from a browser on the same machine
+  const isGame = req.requestedProtocols.indexOf('example-protocol') !== -1 &&
+    (!gameAddress || req.remoteAddress === gameAddress);
+  if (isGame) {
+    console.log('Game connection established');
+
+    gameSocket = req.accept("example-protocol", req.origin);
+    gameSocket.on('message', dispatchGameMessage);
 
     gameSocket.on('close', function(reason, desc) {
       console.log(`Game connection lost. Reason: ${reason}.  Description: ${desc}`);
@@ -72,68 +201,18 @@ wsServer.on('request', function (req) {
     });
   }
   else {
-    console.log(`Other connection from ${req.remoteAddress}`);
+    if (!config.logLoad) {
+      console.log(`Other connection from ${req.remoteAddress}`);
+    }
 
     const addresses = connectionArray.map(c => c.socket.remoteAddress);
-    if (addresses.indexOf(req.remoteAddress) === -1 || connectionArray.length === 0) {
+    if (addresses.indexOf(req.remoteAddress) === -1 || config.allowSameAddress) {
       // Save the connection for later use
       var connection = req.accept(null, req.origin);
       connectionArray.push(connection);
 
       connection.send('Connected');
 
-      gameSocket.on('message', function(msg) {
-        if (msg.type === 'utf8') {
-          var temp = msg.utf8Data;
-          const remotePlayerAddress = connection.socket.remoteAddress;
-          const idNumber = playerList.get(remotePlayerAddress);
-
-          // Receive colour-data from game and send to client
-          if (temp[0] === 'A') {
-            var valOne = temp.substring(7, 14) * 255;
-            var valTwo = temp.substring(17, 24) * 255;
-            var valThree = temp.substring(27, 34) * 255;
-            var playerColourId1 = temp.substring(36);
-            console.log(`PLAYERID: ${playerColourId1}`);
-
-            var colourOne = [valOne, valTwo, valThree];
-            if (playerColourId1 == idNumber) {
-              connection.send(`A ${colourOne}`);
-            }
-
-          } else if (temp[0] === 'B') {
-            var valOne = temp.substring(7, 14) * 255;
-            var valTwo = temp.substring(17, 24) * 255;
-            var valThree = temp.substring(27, 34) * 255;
-            var playerColourId2 = temp.substring(36);
-
-            var colourTwo = [valOne, valTwo, valThree];
-
-            if (playerColourId2 == idNumber) {
-              connection.send(`B ${colourTwo}`);
-            }
-
-            // Receive points from game and send to website
-          } else if (temp[0] === 'P') {
-            var pointsId = temp.substring(2, 4);
-            var points = temp.substring(5);
-
-            if (pointsId == idNumber) {
-              //console.log(`POINTS for player ${pointsId}: ${points}`);
-              connection.send(`P ${points}`);
-            }
-
-          } else if (temp[0] === 'T') {
-            var time = temp.substring(2, 6);
-
-            //console.log(`Colour 2: ${colourTwo}`);
-            connection.send(`T ${time}`);
-          } else if (temp[0] === 'U') {
-            connection.send(temp);
-          }
-        }
-      });
-
       // Do something with the connection
       connection.on('message', function(msg) {
         assert(gameSocket, 'Tried to pass message to game but no connection was open');
@@ -143,45 +222,58 @@ wsServer.on('request', function (req) {
 
           // Testing if first slot has value "N", if so --> send name
           if (temp[0] === "N") {
-            console.log("Sending name: " + temp);
-
+            connection.playerId = uniqueId;
             playerList.set(connection.socket.remoteAddress, uniqueId);
-            console.log(playerList);
-            gameSocket.send(`N ${uniqueId} ${temp[1]}`);
+            playerConnections.set(uniqueId, connection);
+            if (!config.logLoad) {
+              console.log(`Player ${uniqueId} joined as ${temp[1]}`);
+            }
+            sendToGame('N', uniqueId, 0, temp[1]);
             // Send only ID to receive colors
-            gameSocket.send(`I ${uniqueId}`);
+            sendToGame('I', uniqueId);
             uniqueId++;
           }
 
           // Testing if first slot has value "C", if so --> send rotation data
-          else if (temp[0] === "C") {
-            // Test sending some rotation data from the user's mobile device
-            const playerId = playerList.get(req.remoteAddress);
-            gameSocket.send(`C ${playerId} ${temp[1]}`);
+          else if (temp[0] === "C" && connection.playerId !== undefined) {
+            sendToGame('C', connection.playerId, parseFloat(temp[1]));
+          }
+
+          // "Y <token>", the game echoes the token for round trip measurements
+          else if (temp[0] === "Y" && connection.playerId !== undefined) {
+            sendToGame('Y', connection.playerId, 0, temp[1] || '');
           }
         }
       });
 
       // When the connection closes
       connection.on('close', function(reason, desc) {
-        const remoteAddress = connection.socket.remoteAddress;
-        const addresses = connectionArray.map(c => c.socket.remoteAddress);
-        connectionArray.splice(addresses.indexOf(remoteAddress), 1);
-        const id = playerList.get(remoteAddress);
-
-        //if (playerList.delete(remoteAddress)) {
-        gameSocket.send(`D ${id}`);
-        console.log(`Removed player ${id} with ip ${remoteAddress}`);
-        //}
+        connectionArray.splice(connectionArray.indexOf(connection), 1);
+        const id = connection.playerId;
+        if (id === undefined) {
+          return;
+        }
+
+        playerConnections.delete(id);
+        if (playerList.get(connection.socket.remoteAddress) === id) {
+          playerList.delete(connection.socket.remoteAddress);
+        }
+        if (gameSocket) {
+          sendToGame('D', id);
+        }
+        if (!config.logLoad) {
+          console.log(`Removed player ${id} with ip ${connection.socket.remoteAddress}`);
+        }
       });
     }
     // More connections form same device
     else {
       console.log('Same IP address connected twice');
+      req.reject();
     }
     // First connection message with game online
-    if (gameSocket) {
+    if (gameSocket && !config.logLoad) {
       gameSocket.send("Remote connection from: " + req.remoteAddress);
     }
   }
-});
\ No newline at end of file
+});